@@ -2,18 +2,28 @@
 #include <cmath>
 #include <fstream>
 #include <vector>
+#include <cstring>
+#include <cstdio>
+#include <ctime>
+#include <chrono>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
-#include <ao/ao.h>
-#include <mpg123.h>
 
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-#define BITS 8
+#include "world.h"
+#include "jobs.h"
+#include "replay.h"
+#include "netplay.h"
+#include "spectate.h"
+#include "broadcast.h"
+#include "audio.h"
+#include "mixer.h"
+
 
 using namespace std;
 
@@ -119,8 +129,122 @@ static void error_callback(int error, const char* description)
     fprintf(stderr, "Error: %s\n", description);
 }
 
+// --record writes every tick's input here
+InputRecorder recorder;
+// --net plays one side of a two player game against --peer
+NetSession net;
+bool netplay = false;
+// --watch shows a match running on a server instead
+Spectator spectator;
+bool watching = false;
+// --broadcast publishes every frame to viewers on this machine; --view is one
+Feed *feed = NULL;
+const char *feed_name = NULL;
+const Feed *viewed_feed = NULL;
+FeedFrame feed_frame;
+uint32_t feed_seen = 0;
+int feed_retries = 0;
+
+void stopBroadcast ()
+{
+    closeFeed(feed);
+    removeFeed(feed_name);
+}
+
+/* End the network game: hand the other player our last frames and print
+ * how often this side had to correct itself */
+void netFinish ()
+{
+    if(!netplay)
+      return;
+    netClose(net);
+    netplay = false;
+    cout << "\nRollbacks : " << net.rollbacks << ", ticks run again : " << net.resimulated
+         << ", waits : " << net.stalls << endl;
+}
+
+/* Let the last effect play out, stop the music and say whether the
+ * device ever ran dry and what mixing the effects in cost */
+void finishAudio ()
+{
+    drainAudio(1500);
+    stopAudio();
+    AudioCounters audio = audioCounters();
+    cout << "\nAudio periods : " << audio.periods << ", underruns : " << audio.underruns
+         << ", silent bytes : " << audio.silent_bytes << ", overruns : " << audio.overruns << endl;
+    const AudioHistograms &times = audioHistograms();
+    cout << "Effect latency : " << histogramPercentile(times.latency_ns, 0.5) / 1e6 << " ms median, "
+         << histogramPercentile(times.latency_ns, 0.99) / 1e6 << " ms at the 99th percentile" << endl;
+    cout << "Effects : " << audio.sfx_played << " played, " << audio.sfx_stolen << " cut short, "
+         << audio.sfx_dropped << " dropped; mixing (" << mixKernel() << ") "
+         << audio.mix_ns / max(audio.periods, 1LL) / 1000.0 << " us a block on average, "
+         << audio.mix_ns_max / 1000.0 << " us at worst, of " << audio.period_ns / 1000.0 << " us; "
+         << audio.slow_mixes << " blocks over a tenth" << endl;
+}
+
+/* --metrics: a CSV row a second of frame times and the audio path, and
+ * one more at exit; latencies are cumulative percentiles, counts totals */
+FILE *metrics = NULL;
+Histogram frame_ns;
+chrono::steady_clock::time_point metrics_start, metrics_due;
+int metrics_ticks = 0;
+
+void writeMetrics ()
+{
+    AudioCounters audio = audioCounters();
+    const AudioHistograms &times = audioHistograms();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - metrics_start).count();
+    fprintf(metrics, "%.3f,%lld,%d,%.3f,%.3f,%.3f,%lld,%lld,%lld,%lld,%lld,%lld,%.1f,%.1f,%.1f,%.3f,%.3f,%.3f,%.3f,%lld,%lld\n",
+            seconds, frame_ns.total.load(), metrics_ticks, histogramPercentile(frame_ns, 0.5) / 1e6,
+            histogramPercentile(frame_ns, 0.99) / 1e6, frame_ns.max.load() / 1e6, audio.periods, audio.underruns,
+            audio.overruns, audio.silent_bytes, histogramPercentile(times.fill_percent, 0.01),
+            histogramPercentile(times.fill_percent, 0.5), histogramPercentile(times.decode_ns, 0.5) / 1e3,
+            histogramPercentile(times.decode_ns, 0.99) / 1e3, histogramPercentile(times.mix_ns, 0.99) / 1e3,
+            histogramPercentile(times.play_ns, 0.5) / 1e6, histogramPercentile(times.latency_ns, 0.5) / 1e6,
+            histogramPercentile(times.latency_ns, 0.99) / 1e6, times.latency_ns.max.load() / 1e6,
+            audio.sfx_played, audio.sfx_dropped);
+    fflush(metrics);
+}
+
+bool startMetrics (const char *path)
+{
+    metrics = fopen(path, "w");
+    if(!metrics)
+      return false;
+    fprintf(metrics, "seconds,frames,ticks,frame_p50_ms,frame_p99_ms,frame_max_ms,audio_blocks,underruns,overruns,"
+            "silent_bytes,fill_p1_percent,fill_p50_percent,decode_p50_us,decode_p99_us,mix_p99_us,play_p50_ms,"
+            "sfx_latency_p50_ms,sfx_latency_p99_ms,sfx_latency_max_ms,sfx_played,sfx_dropped\n");
+    metrics_start = metrics_due = chrono::steady_clock::now();
+    return true;
+}
+
+/* A frame took frame_seconds and the game is at ticks */
+void frameMetrics (double frame_seconds, int ticks)
+{
+    if(!metrics)
+      return;
+    addSample(frame_ns, (long long)(frame_seconds * 1e9));
+    metrics_ticks = ticks;
+    if(chrono::steady_clock::now() >= metrics_due)
+    {
+      writeMetrics();
+      metrics_due += chrono::seconds(1);
+    }
+}
+
+void stopMetrics ()
+{
+    if(!metrics)
+      return;
+    writeMetrics();
+    fclose(metrics);
+    metrics = NULL;
+}
+
 void quit(GLFWwindow *window)
 {
+    stopRecording(recorder);
+    netFinish();
     glfwDestroyWindow(window);
     glfwTerminate();
 //    exit(EXIT_SUCCESS);
@@ -220,69 +344,8 @@ int flag1=0, flag2=0, flag3;
 void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
 {
      // Function is called first on GLFW_PRESS.
-
-  if(glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS && glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
-  {
-    q1=q1+0.2;
-    flag3=1;
-  }
-  if(glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS && glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
-  {
-    q1=q1-0.2;
-    flag3=1;
-  }
-  if(glfwGetKey(window, GLFW_KEY_LEFT_ALT) == GLFW_PRESS && glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
-  {
-    q2=q2+0.2;
-    flag3=1;
-  }
-  if(glfwGetKey(window, GLFW_KEY_LEFT_ALT) == GLFW_PRESS && glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
-  {
-    q2=q2-0.2;
-    flag3=1;
-  }
-
-  if(glfwGetKey(window, GLFW_KEY_S)==GLFW_PRESS)
-  {
-    q3=q3+0.2;
-    flag3=0;
-  }
-  if(glfwGetKey(window, GLFW_KEY_F)==GLFW_PRESS)
-  {
-    q3=q3-0.2;
-    flag3=0;
-  }
-  if(glfwGetKey(window, GLFW_KEY_A)==GLFW_PRESS)
-  {
-    angle=angle+5;
-    flag3=0;
-  }
-  if(glfwGetKey(window, GLFW_KEY_D)==GLFW_PRESS)
-  {
-    angle=angle-5;
-    flag3=0;
-  }
-  if(glfwGetKey(window, GLFW_KEY_UP)==GLFW_PRESS)
-  {
-    zoom=zoom-0.1;
-    flag3=0;
-  }
-  if(glfwGetKey(window, GLFW_KEY_DOWN)==GLFW_PRESS)
-  {
-    zoom=zoom+0.1;
-    flag3=0;
-  }
-  else if(glfwGetKey(window, GLFW_KEY_LEFT)==GLFW_PRESS && glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_RELEASE && glfwGetKey(window, GLFW_KEY_LEFT_ALT) == GLFW_RELEASE)
-  {
-    pan=pan-0.1;
-    flag3=0;
-  }
-  else if(glfwGetKey(window, GLFW_KEY_RIGHT)==GLFW_PRESS && glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_RELEASE && glfwGetKey(window, GLFW_KEY_LEFT_ALT) == GLFW_RELEASE)
-  {
-    pan=pan+0.1;
-    flag3=0;
-  }
-
+  // Actions are applied at the next tick
+  inputKeyEvent(key, action, mods);
 }
 
 /* Executed for character input (like in text boxes) */
@@ -343,7 +406,7 @@ void reshapeWindow (GLFWwindow* window, int width, int height)
     Matrices.projection = glm::ortho(-4.0f-zoom+pan, 4.0f+zoom+pan, -4.0f-zoom, 4.0f+zoom, 0.1f, 500.0f);
 }
 
-VAO *triangle, *redbasket, *greenbasket, *shooter, *redbrick, *greenbrick, *blackbrick, *mirror1, *mirror2, *mirror3, *mirror4, *lazer, *stand;
+VAO *triangle, *redbasket, *greenbasket, *shooter, *redbrick, *greenbrick, *blackbrick, *mirror, *lazer, *stand;
 
 // Creates the triangle object used in this sample code
 void createShooter ()
@@ -503,17 +566,18 @@ void createRedBrick()
   redbrick = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
 }
 
-void createMirror1()
+// Mirrors are drawn from one unit-length bar, scaled and rotated onto each segment
+void createMirror()
 {
   // GL3 accepts only Triangles. Quads are not supported
   static const GLfloat vertex_buffer_data [] = {
-    -0.24,-0.3,0, // vertex 1
-    0.3, 0.3,0, // vertex 2
-    0.24, 0.3,0, // vertex 3
+    -1,-0.025,0, // vertex 1
+    1,-0.025,0, // vertex 2
+    1, 0.025,0, // vertex 3
 
-    0.24, 0.3,0, // vertex 3
-    -0.3, -0.3,0, // vertex 4
-    -0.24,-0.3,0  // vertex 1
+    1, 0.025,0, // vertex 3
+    -1, 0.025,0, // vertex 4
+    -1,-0.025,0  // vertex 1
   };
 
   static const GLfloat color_buffer_data [] = {
@@ -527,88 +591,7 @@ void createMirror1()
   };
 
   // create3DObject creates and returns a handle to a VAO that can be used later
-  mirror1 = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
-}
-
-void createMirror2()
-{
-  // GL3 accepts only Triangles. Quads are not supported
-  static const GLfloat vertex_buffer_data [] = {
-    -0.24,-0.3,0, // vertex 1
-    0.3, 0.3,0, // vertex 2
-    0.24, 0.3,0, // vertex 3
-
-    0.24, 0.3,0, // vertex 3
-    -0.3, -0.3,0, // vertex 4
-    -0.24,-0.3,0  // vertex 1
-  };
-
-  static const GLfloat color_buffer_data [] = {
-    0.6, 0.8, 1, // color 1
-    0.6, 0.8, 1, // color 2
-    0.6, 0.8, 1, // color 3
-
-    0.6, 0.8, 1, // color 3
-    0.6, 0.8, 1, // color 4
-    0.6, 0.8, 1  // color 1
-  };
-
-  // create3DObject creates and returns a handle to a VAO that can be used later
-  mirror2 = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
-}
-
-void createMirror3()
-{
-  // GL3 accepts only Triangles. Quads are not supported
-  static const GLfloat vertex_buffer_data [] = {
-    0.3,-0.3,0, // vertex 1
-    -0.24, 0.3,0, // vertex 2
-    -0.3, 0.3,0, // vertex 3
-
-    -0.3, 0.3,0, // vertex 3
-    0.24, -0.3,0, // vertex 4
-    0.3,-0.3,0  // vertex 1
-  };
-
-  static const GLfloat color_buffer_data [] = {
-    0.6, 0.8, 1, // color 1
-    0.6, 0.8, 1, // color 2
-    0.6, 0.8, 1, // color 3
-
-    0.6, 0.8, 1, // color 3
-    0.6, 0.8, 1, // color 4
-    0.6, 0.8, 1  // color 1
-  };
-
-  // create3DObject creates and returns a handle to a VAO that can be used later
-  mirror3 = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
-}
-
-void createMirror4()
-{
-  // GL3 accepts only Triangles. Quads are not supported
-  static const GLfloat vertex_buffer_data [] = {
-    0.3,-0.3,0, // vertex 1
-    -0.24, 0.3,0, // vertex 2
-    -0.3, 0.3,0, // vertex 3
-
-    -0.3, 0.3,0, // vertex 3
-    0.24, -0.3,0, // vertex 4
-    0.3,-0.3,0  // vertex 1
-  };
-
-  static const GLfloat color_buffer_data [] = {
-    0.6, 0.8, 1, // color 1
-    0.6, 0.8, 1, // color 2
-    0.6, 0.8, 1, // color 3
-
-    0.6, 0.8, 1, // color 3
-    0.6, 0.8, 1, // color 4
-    0.6, 0.8, 1  // color 1
-  };
-
-  // create3DObject creates and returns a handle to a VAO that can be used later
-  mirror4 = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
+  mirror = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
 }
 
 void createLazer()
@@ -673,21 +656,112 @@ float greenbri_rotation = 0;
 float blackbri_rotation = 0;
 float bri_rotation = 0;
 float shooter_rotation = 0;
-float mirror1_rotation = 0;
-float mirror2_rotation = 0;
-float mirror3_rotation = 0;
-float mirror4_rotation = 0;
 float lazer_rotation=0;
 float stand_rotation=0;
 
 /* Render the scene with openGL */
 /* Edit this function according to your assignment */
-int n=0, ct=0, n1=0, ct1=0;
-vector<float> x,y,z, r, s, t, u, e, p, f, h;
-float a,b,c, a1, b1, c1, d1, s_x, s_y, t_r, m1, m2,m3,m4,m5,m6,m7,m8;
-int delay = 0, life=5, score=0, penalty=0;
+World world;
+
+/* The simulation runs at a fixed 60 ticks per second, the rate all the per
+ * tick speeds and counters were tuned for; rendering runs at any rate */
+#define TICK (1.0/60)
+/* Longest stretch of real time simulated per frame, so a stall doesn't
+ * turn into a burst of catch-up ticks */
+#define MAX_FRAME_TIME 0.25
+
+// Events of network ticks both players' input is in for
+vector<WorldEvent> final_events;
+
+/* Print what happened during the last ticks; the game ends at the first
+ * game over. fire_played: the shots were heard already, from the
+ * predicted ticks */
+void reportEvents (const vector<WorldEvent> &events, bool fire_played = false)
+{
+  for(int k=0; k<(int)events.size(); k++)
+  {
+    const WorldEvent &event = events[k];
+    if(event.type == EVENT_FIRE && !fire_played)
+      playSfx(SFX_FIRE);
+    else if(event.type == EVENT_HIT)
+      playSfx(SFX_HIT);
+    else if(event.type == EVENT_CATCH)
+      playSfx(SFX_CATCH);
+    else if(event.type == EVENT_LIVES_OVER)
+    {
+      playSfx(SFX_GAME_OVER);
+      cout<<"\nLives Over!! GAME OVER!!!\n";
+      stopRecording(recorder);
+      netFinish();
+      exit(0);
+    }
+    else if(event.type == EVENT_BLACK_BRICK)
+    {
+      playSfx(SFX_GAME_OVER);
+      cout<<"\nBlack Brick in the Hole!! GAME OVER!!!\n";
+      stopRecording(recorder);
+      netFinish();
+      exit(0);
+    }
+    if(event.type == EVENT_SCORE)
+      cout<<"\nScore : "<<event.score<<"\nLife : "<<event.life<<endl;
+  }
+}
+
+/* In a network game, the sounds of a tick that can't change when the
+ * other player's input arrives, played as soon as it is predicted rather
+ * than up to NET_WINDOW ticks later when it is final. The shooter's shots
+ * depend on its own keys alone. */
+void reportLocalEvents (const vector<WorldEvent> &events)
+{
+  if(net.role != NET_SHOOTER)
+    return;
+  for(int k=0; k<(int)events.size(); k++)
+  {
+    if(events[k].type == EVENT_FIRE)
+      playSfx(SFX_FIRE);
+  }
+}
+
+/* Print what changed in a game shown from elsewhere; a server starts a
+ * new game after each game over, and the showing goes on */
+void reportShown (int shown_score, int shown_life, bool shown_over)
+{
+  static int score = 0, life = 0;
+  static bool over = false;
+  if(shown_over && !over)
+    cout<<"\nGAME OVER!!!\n";
+  else if(shown_score != score || shown_life != life)
+    cout<<"\nScore : "<<shown_score<<"\nLife : "<<shown_life<<endl;
+  score = shown_score;
+  life = shown_life;
+  over = shown_over;
+}
+
+/* The camera moves here; the rest of the input goes to the world */
+void viewInput (const InputFrame &input)
+{
+  if(inputStepped(input, INPUT_ZOOM_IN))
+  {
+    zoom=zoom-0.1;
+  }
+  if(inputStepped(input, INPUT_ZOOM_OUT))
+  {
+    zoom=zoom+0.1;
+  }
+  else if(inputStepped(input, INPUT_PAN_LEFT))
+  {
+    pan=pan-0.1;
+  }
+  else if(inputStepped(input, INPUT_PAN_RIGHT))
+  {
+    pan=pan+0.1;
+  }
+}
 
-void draw (GLFWwindow* window)
+/* Render the latest tick; alpha (0..1) is how far real time has moved
+ * towards the next tick, used to interpolate the moving objects */
+void draw (GLFWwindow* window, float alpha)
 {
   //flag3=0;
   // clear the color and depth in the frame buffer
@@ -718,79 +792,13 @@ void draw (GLFWwindow* window)
   //  Don't change unless you are sure!!
   glm::mat4 MVP;	// MVP = Projection * View * Model
 
-  ct++;
-  if(ct==90)
-  {
-    a=rand()%7 +0.85;
-    a=a-3;
-    b=4.2;
-    c=rand()%3;
-    x.push_back(a);
-    y.push_back(b);
-    z.push_back(c);
-    e.push_back(1);
-    ct=0;
-    n++;
-  }
-  delay++;
-
-  if(glfwGetKey(window, GLFW_KEY_SPACE)==GLFW_PRESS && delay >= 60)
-  {
-    delay = 0;
-    a1=0;
-    b1=q3;
-    c1=angle;
-    d1=sin(angle * M_PI/180.0f) * 0.45;
-    r.push_back(a1);
-    s.push_back(b1);
-    t.push_back(c1);
-    u.push_back(d1);
-    p.push_back(1);
-    f.push_back(0);
-    h.push_back(0);
-    n1++;
-  }
-
-  if(-2+q1>=3.5)
-  {
-    q1=q1-0.2;
-  }
-  if(-2+q1<= -2)
-  {
-    q1=q1+0.2;
-  }
-  if(2+q2>=3.5)
-  {
-    q2=q2-0.2;
-  }
-  if(2+q2<= -2)
-  {
-    q2=q2+0.2;
-  }
-  if(q3>=3.75)
-  {
-    q3=q3-0.2;
-  }
-  if(q3<= -3.75)
-  {
-    q3=q3+0.2;
-  }
-  if(angle>=80)
-  {
-    angle=angle-5;
-  }
-  if(angle<= -80)
-  {
-    angle=angle+5;
-  }
-
   // Load identity to model matrix
   Matrices.model = glm::mat4(1.0f);
 
   /* Render your scene */
-  shooter_rotation=angle;
+  shooter_rotation=world.angle;
 
-  glm::mat4 translateTriangle = glm::translate (glm::vec3(-3.75f, q3, 0.0f)); // glTranslatef
+  glm::mat4 translateTriangle = glm::translate (glm::vec3(-3.75f, world.q3, 0.0f)); // glTranslatef
   glm::mat4 rotateTriangle = glm::rotate((float)(shooter_rotation*M_PI/180.0f), glm::vec3(0,0,1));  // rotate about vector (1,0,0)
   glm::mat4 triangleTransform = translateTriangle * rotateTriangle;
   Matrices.model *= triangleTransform; 
@@ -802,118 +810,26 @@ void draw (GLFWwindow* window)
   // draw3DObject draws the VAO given to it using current MVP matrix
   draw3DObject(shooter);
 
-  for(int i=0; i<n1; i++)
-  {
-    if(p[i] == 1)
-    {
-      s_x= -3.45 + f[i] + r[i] * cos((lazer_rotation*M_PI/180.0f)); //+ 0.15*cos((lazer_rotation*M_PI/180.0f));
-      s_y= s[i] + u[i] + h[i] + r[i] * sin((lazer_rotation*M_PI/180.0f)); //+ 0.15*sin((lazer_rotation*M_PI/180.0f)) ;
-      for(int w=0; w<n;w++)
-      {
-        if(e[w] == 1)
-        {
-          if((s_x >= x[w]-0.125 && s_x <= x[w]+0.125)&&(s_y >= y[w]-0.15 && s_y <= y[w]+0.15))
-          {
-            e[w]=0;
-            p[i]=0;
-            if(z[w]==0)
-            {
-              life=life-1;
-            }
-            else if(z[w]==1)
-            {
-              life=life-1;
-            }
-            else if(z[w]==2)
-            {
-              score=score+1;
-            }
-            if(life==0)
-            {
-              cout<<"\nLives Over!! GAME OVER!!!\n";
-              exit(0);
-            }
-            cout<<"\nScore : "<<score<<"\nLife : "<<life<<endl;
-          }
-        }
-      }
-    }
-  }
-  for(int j=0;j<n1;j++)
+  for(int j=0;j<world.n1;j++)
   {  
-    if(p[j]==1)
+    if(world.p[j]==1)
     {
-      lazer_rotation=t[j];
+      float lx, ly, dx, dy;
+      int seg = world.beam_seg[j];
+      lazerPoint(world, j, max(world.r[j] - LAZER_STEP*(1-alpha), 0.0f), seg, lx, ly, dx, dy);
       Matrices.model = glm::mat4(1.0f);
-      glm::mat4 translateRectangle11 = glm::translate (glm::vec3(-3.45f+f[j], s[j] + u[j] + h[j], 0));        // glTranslatef
-      glm::mat4 rotateRectangle11 = glm::rotate((float)(lazer_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-      glm::mat4 translateRectangle12 = glm::translate (glm::vec3(r[j], 0, 0));        // glTranslatef
-      Matrices.model *= (translateRectangle11 * rotateRectangle11 * translateRectangle12);
+      glm::mat4 translateRectangle11 = glm::translate (glm::vec3(lx, ly, 0));        // glTranslatef
+      glm::mat4 rotateRectangle11 = glm::rotate((float)atan2(dy, dx), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
+      Matrices.model *= (translateRectangle11 * rotateRectangle11);
       MVP = VP * Matrices.model;
       glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
       // draw3DObject draws the VAO given to it using current MVP matrix
       draw3DObject(lazer);
-      r[j]=r[j]+0.1;
     }
   }
-  for(int i=0; i<n1; i++)
-  {
-    if(p[i]==1)
-    {
-      s_x= -3.45 + f[i] + r[i] * cos((lazer_rotation*M_PI/180.0f)); //+ 0.15*cos((lazer_rotation*M_PI/180.0f));
-      s_y= s[i] + u[i] + h[i] + r[i] * sin((lazer_rotation*M_PI/180.0f)); //+ 0.15*sin((lazer_rotation*M_PI/180.0f)) ;
-      m1=1.11;
-      m2=(s_y+1.7)/(s_x-3.24);
-      m3=1.11;
-      m4=(s_y-0.3)/(s_x-0.24);
-      m5=-1.11;
-      m6=(s_y-3.3)/(s_x-2.7);
-      m7=-1.11;
-      m8=(s_y-3.3)/(s_x+0.3);
-      if((m2<=m1+0.5 && m2>=m1-0.5) && (s_x<=3.24 && s_x>=2.7) && (s_y >= -2.3 && s_y<= -1.7))
-      {
-        f[i]=s_x+3.45;
-        h[i]=s_y-(s[i]+u[i]);
-        r[i]=0;
-        t[i]=t[i]+96;
-      }
-      else if((m4<=m3+0.5 && m4>=m3-0.5) && (s_x<=0.24 && s_x>=-0.3) && (s_y >= -0.3 && s_y<= 0.3))
-      {
-        f[i]=s_x+3.45;
-        h[i]=s_y-(s[i]+u[i]);
-        r[i]=0;
-        t[i]=t[i]+96;
-      }
-      else if((m6<=m5+0.5 && m6>=m5-0.5) && (s_x<=3.24 && s_x>=2.7) && (s_y >= 2.7 && s_y<= 3.3))
-      {
-        f[i]=s_x+3.45;
-        h[i]=s_y-(s[i]+u[i]);
-        r[i]=0;
-        t[i]=t[i]+144;
-      }
-      else if((m8<=m7+0.5 && m8>=m7-0.5) && (s_x<=0.24 && s_x>=-0.3) && (s_y >= 2.7 && s_y<= 3.3))
-      {
-        f[i]=s_x+3.45;
-        h[i]=s_y-(s[i]+u[i]);
-        r[i]=0;
-        t[i]=t[i]+144;
-      }
-    }
-
-    /*for(int w=0; w<n;w++)
-    {
-      if((s_x >= x[w]-0.125 && s_x <= x[w]+0.125)&&(s_y >= y[w]-0.15 && s_y <= y[w]+0.15))
-      {
-        e[w]=0;
-        p[w]=0;
-      }
-    }*/
-
-  }
-
   Matrices.model = glm::mat4(1.0f);
 
-  glm::mat4 translateRectangle14 = glm::translate (glm::vec3(-3.875f, q3, 0.0f));        // glTranslatef
+  glm::mat4 translateRectangle14 = glm::translate (glm::vec3(-3.875f, world.q3, 0.0f));        // glTranslatef
   glm::mat4 rotateRectangle14 = glm::rotate((float)(green_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
   Matrices.model *= (translateRectangle14 * rotateRectangle14);
   MVP = VP * Matrices.model;
@@ -926,7 +842,7 @@ void draw (GLFWwindow* window)
   // glPopMatrix ();
   Matrices.model = glm::mat4(1.0f);
 
-  glm::mat4 translateRectangle1 = glm::translate (glm::vec3(2+q2, -3.4, 0));        // glTranslatef
+  glm::mat4 translateRectangle1 = glm::translate (glm::vec3(2+world.q2, -3.4, 0));        // glTranslatef
   glm::mat4 rotateRectangle1 = glm::rotate((float)(green_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
   Matrices.model *= (translateRectangle1 * rotateRectangle1);
   MVP = VP * Matrices.model;
@@ -935,99 +851,45 @@ void draw (GLFWwindow* window)
   // draw3DObject draws the VAO given to it using current MVP matrix
   draw3DObject(greenbasket);
 
-  for(int k=0; k<n; k++)
-  {
-    if(e[k] == 1)
-    {
-      if((x[k] >= -2.5+q1 && x[k] <= -1.5+q1 && y[k] <= -2.82 && y[k] >= -2.85))
-      {
-        e[k]=0;
-        if(z[k]==0)
-        {
-          score=score+1;
-        }
-        else if(z[k]==1)
-        {
-          score=score-1;
-        }
-        else if(z[k]==2)
-        {
-          cout<<"\nBlack Brick in the Hole!! GAME OVER!!!\n";
-          exit(0);
-        }
-        cout<<"\nScore : "<<score<<"\nLife : "<<life<<endl;
-      }
-      if((x[k] >= 1.5+q2 && x[k] <= 2.5+q2 && y[k] <= -2.82 && y[k] >= -2.85))
-      {
-        e[k]=0;
-        if(z[k]==0)
-        {
-          score=score-1;
-        }
-        else if(z[k]==1)
-        {
-          score=score+1;
-        }
-        else if(z[k]==2)
-        {
-          cout<<"\nBlack Brick in the Hole!! GAME OVER!!!\n";
-          exit(0);
-        }
-        cout<<"\nScore : "<<score<<"\nLife : "<<life<<endl;
-      }
-    }
-  }
-  for(int i=0;i<n;i++)
+  for(int i=0;i<world.n;i++)
   {  
     
     Matrices.model = glm::mat4(1.0f);
 
-    glm::mat4 translateRectangle3 = glm::translate (glm::vec3(x[i], y[i], 0));        // glTranslatef
+    glm::mat4 translateRectangle3 = glm::translate (glm::vec3(world.x[i], world.y[i] + world.fall_step*(1-alpha), 0));        // glTranslatef
     glm::mat4 rotateRectangle3 = glm::rotate((float)(bri_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
     Matrices.model *= (translateRectangle3 * rotateRectangle3);
     MVP = VP * Matrices.model;
     glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-    if(z[i]==0)
+    if(world.z[i]==0)
     {
-      if(e[i]==1)
+      if(world.e[i]==1)
       {
         // draw3DObject draws the VAO given to it using current MVP matrix
         draw3DObject(redbrick);
       }
     }
-    else if(z[i]==1)
+    else if(world.z[i]==1)
     {
-      if(e[i]==1)
+      if(world.e[i]==1)
       {
         // draw3DObject draws the VAO given to it using current MVP matrix
         draw3DObject(greenbrick);
       }
     }
-    else if(z[i]==2)
+    else if(world.z[i]==2)
     {
-      if(e[i]==1)
+      if(world.e[i]==1)
       {
         // draw3DObject draws the VAO given to it using current MVP matrix
         draw3DObject(blackbrick);
       }
     }
-    if(glfwGetKey(window, GLFW_KEY_N)==GLFW_PRESS)
-    {
-      y[i]=y[i]-0.1;
-    }
-    else if(glfwGetKey(window, GLFW_KEY_M)==GLFW_PRESS)
-    {
-      y[i]=y[i]-0.002;
-    }
-    else
-    {
-      y[i]=y[i]-0.007;
-    }
   }
 
   Matrices.model = glm::mat4(1.0f);
 
-  glm::mat4 translateRectangle2 = glm::translate (glm::vec3(-2+q1, -3.4, 0));        // glTranslatef
+  glm::mat4 translateRectangle2 = glm::translate (glm::vec3(-2+world.q1, -3.4, 0));        // glTranslatef
   glm::mat4 rotateRectangle2 = glm::rotate((float)(red_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
   Matrices.model *= (translateRectangle2 * rotateRectangle2);
   MVP = VP * Matrices.model;
@@ -1058,50 +920,20 @@ void draw (GLFWwindow* window)
   // draw3DObject draws the VAO given to it using current MVP matrix
   // draw3DObject(blackbrick);
 
-  Matrices.model = glm::mat4(1.0f);
-
-  glm::mat4 translateRectangle6 = glm::translate (glm::vec3(3, -2, 0));        // glTranslatef
-  glm::mat4 rotateRectangle6 = glm::rotate((float)(mirror1_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-  Matrices.model *= (translateRectangle6 * rotateRectangle6);
-  MVP = VP * Matrices.model;
-  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-  // draw3DObject draws the VAO given to it using current MVP matrix
-  draw3DObject(mirror1);
-
-  Matrices.model = glm::mat4(1.0f);
-
-  glm::mat4 translateRectangle7 = glm::translate (glm::vec3(0, 0, 0));        // glTranslatef
-  glm::mat4 rotateRectangle7 = glm::rotate((float)(mirror2_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-  Matrices.model *= (translateRectangle7 * rotateRectangle7);
-  MVP = VP * Matrices.model;
-  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-  // draw3DObject draws the VAO given to it using current MVP matrix
-  draw3DObject(mirror2);
-
-  Matrices.model = glm::mat4(1.0f);
-
-  glm::mat4 translateRectangle8 = glm::translate (glm::vec3(3, 3, 0));        // glTranslatef
-  glm::mat4 rotateRectangle8 = glm::rotate((float)(mirror3_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-  Matrices.model *= (translateRectangle8 * rotateRectangle8);
-  MVP = VP * Matrices.model;
-  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-  // draw3DObject draws the VAO given to it using current MVP matrix
-  draw3DObject(mirror3);
-
-  Matrices.model = glm::mat4(1.0f);
-
-  glm::mat4 translateRectangle9 = glm::translate (glm::vec3(0, 3, 0));        // glTranslatef
-  glm::mat4 rotateRectangle9 = glm::rotate((float)(mirror4_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-  Matrices.model *= (translateRectangle9 * rotateRectangle9);
-  MVP = VP * Matrices.model;
-  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+  for(int k=0; k<(int)world.mirrors.size(); k++)
+  {
+    Matrices.model = glm::mat4(1.0f);
 
-  // draw3DObject draws the VAO given to it using current MVP matrix
-  draw3DObject(mirror4);
+    glm::mat4 translateMirror = glm::translate (glm::vec3(world.mirrors[k].cx, world.mirrors[k].cy, 0));        // glTranslatef
+    glm::mat4 rotateMirror = glm::rotate((float)(world.mirrors[k].angle*M_PI/180.0f), glm::vec3(0,0,1));
+    glm::mat4 scaleMirror = glm::scale (glm::vec3(world.mirrors[k].half_len, 1, 1));
+    Matrices.model *= (translateMirror * rotateMirror * scaleMirror);
+    MVP = VP * Matrices.model;
+    glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
 
+    // draw3DObject draws the VAO given to it using current MVP matrix
+    draw3DObject(mirror);
+  }
 
   // Increment angles
   float increments = 0;
@@ -1114,14 +946,13 @@ void draw (GLFWwindow* window)
   greenbri_rotation = greenbri_rotation + increments*rectangle_rot_dir*rectangle_rot_status;
   blackbri_rotation = blackbri_rotation + increments*rectangle_rot_dir*rectangle_rot_status;
   bri_rotation = bri_rotation + increments*rectangle_rot_dir*rectangle_rot_status;
-  mirror1_rotation = mirror1_rotation + increments*rectangle_rot_dir*rectangle_rot_status;
-  mirror2_rotation = mirror2_rotation + increments*rectangle_rot_dir*rectangle_rot_status;
-  mirror3_rotation = mirror3_rotation + increments*rectangle_rot_dir*rectangle_rot_status;
-  mirror4_rotation = mirror4_rotation + increments*rectangle_rot_dir*rectangle_rot_status;
   lazer_rotation = lazer_rotation + increments*rectangle_rot_dir*rectangle_rot_status;
   stand_rotation = stand_rotation + increments*rectangle_rot_dir*rectangle_rot_status;
 }
 
+/* Frames between buffer swaps: 1 is vsync, 0 renders uncapped */
+int swap_interval = 1;
+
 /* Initialise glfw window, I/O callbacks and the renderer to use */
 /* Nothing to Edit here */
 GLFWwindow* initGLFW (int width, int height)
@@ -1147,7 +978,7 @@ GLFWwindow* initGLFW (int width, int height)
 
     glfwMakeContextCurrent(window);
     gladLoadGLLoader((GLADloadproc) glfwGetProcAddress);
-    glfwSwapInterval( 1 );
+    glfwSwapInterval( swap_interval );
 
     /* --- register callbacks with GLFW --- */
 
@@ -1182,10 +1013,7 @@ void initGL (GLFWwindow* window, int width, int height)
   createGreenBasket ();
   createGreenBrick ();
   createBlackBrick ();
-  createMirror1 ();
-  createMirror2 ();
-  createMirror3 ();
-  createMirror4 ();
+  createMirror ();
   createLazer();
   createStand();
 	
@@ -1210,62 +1038,300 @@ void initGL (GLFWwindow* window, int width, int height)
     cout << "GLSL: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << endl;
 }
 
+/* HOST:PORT into its parts */
+bool splitAddress (const char *address, string &host, int &port)
+{
+    host = address;
+    size_t colon = host.rfind(':');
+    if(colon == string::npos)
+      return false;
+    port = atoi(host.c_str() + colon + 1);
+    host.erase(colon);
+    return true;
+}
+
 int main (int argc, char** argv)
 {
 	int width = 600;
 	int height = 600;
+    int threads = 0;
+    // A different game each run unless --seed asks for a particular one
+    uint64_t seed = time(NULL);
+    const char *record_path = NULL, *replay_path = NULL;
+    int net_role = -1, net_port = 7000, peer_port = 7001;
+    string peer_host = "127.0.0.1";
+    const char *watch_address = NULL, *view_name = NULL;
+    int watch_match = 0;
+    int audio_backend = AUDIO_LIVE;
+    const char *audio_file = "brickbreaker.wav";
+    const char *metrics_path = NULL;
+
+    for(int i=1; i<argc; i++)
+    {
+      if(strcmp(argv[i], "--collision") == 0 && i+1 < argc)
+      {
+        world.collision_backend = parseCollisionBackend(argv[++i]);
+        if(world.collision_backend < 0)
+        {
+          cerr << "--collision takes brute, grid or sap" << endl;
+          return 1;
+        }
+      }
+      else if(strcmp(argv[i], "--swap-interval") == 0 && i+1 < argc)
+      {
+        swap_interval = atoi(argv[++i]);
+      }
+      else if(strcmp(argv[i], "--threads") == 0 && i+1 < argc)
+      {
+        threads = atoi(argv[++i]);
+      }
+      else if(strcmp(argv[i], "--seed") == 0 && i+1 < argc)
+      {
+        seed = strtoull(argv[++i], NULL, 10);
+      }
+      else if(strcmp(argv[i], "--record") == 0 && i+1 < argc)
+      {
+        record_path = argv[++i];
+      }
+      else if(strcmp(argv[i], "--replay") == 0 && i+1 < argc)
+      {
+        replay_path = argv[++i];
+      }
+      else if(strcmp(argv[i], "--net") == 0 && i+1 < argc)
+      {
+        i++;
+        if(strcmp(argv[i], "shooter") == 0)
+          net_role = NET_SHOOTER;
+        else if(strcmp(argv[i], "baskets") == 0)
+          net_role = NET_BASKETS;
+        else
+        {
+          cerr << "--net takes shooter or baskets" << endl;
+          return 1;
+        }
+      }
+      else if(strcmp(argv[i], "--port") == 0 && i+1 < argc)
+      {
+        net_port = atoi(argv[++i]);
+      }
+      else if(strcmp(argv[i], "--peer") == 0 && i+1 < argc)
+      {
+        if(!splitAddress(argv[++i], peer_host, peer_port))
+        {
+          cerr << "--peer takes HOST:PORT" << endl;
+          return 1;
+        }
+      }
+      else if(strcmp(argv[i], "--watch") == 0 && i+1 < argc)
+      {
+        watch_address = argv[++i];
+      }
+      else if(strcmp(argv[i], "--match") == 0 && i+1 < argc)
+      {
+        watch_match = atoi(argv[++i]);
+      }
+      else if(strcmp(argv[i], "--broadcast") == 0 && i+1 < argc)
+      {
+        feed_name = argv[++i];
+      }
+      else if(strcmp(argv[i], "--view") == 0 && i+1 < argc)
+      {
+        view_name = argv[++i];
+      }
+      else if(strcmp(argv[i], "--audio") == 0 && i+1 < argc)
+      {
+        audio_backend = parseAudioBackend(argv[++i]);
+        if(audio_backend < 0)
+        {
+          cerr << "--audio takes live, wav or null" << endl;
+          return 1;
+        }
+      }
+      else if(strcmp(argv[i], "--audio-file") == 0 && i+1 < argc)
+      {
+        audio_file = argv[++i];
+      }
+      else if(strcmp(argv[i], "--metrics") == 0 && i+1 < argc)
+      {
+        metrics_path = argv[++i];
+      }
+    }
+    // A replay plays its own seed and ignores the keyboard
+    InputReplay replay;
+    if(replay_path)
+    {
+      if(!loadReplay(replay, replay_path))
+      {
+        cerr << "can't read the recording " << replay_path << endl;
+        return 1;
+      }
+      seed = replay.seed;
+    }
+    if(record_path && !startRecording(recorder, record_path, seed))
+    {
+      cerr << "can't write the recording " << record_path << endl;
+      return 1;
+    }
+    if(net_role >= 0 && (record_path || replay_path))
+    {
+      cerr << "--record and --replay are for one player games" << endl;
+      return 1;
+    }
+    startJobs(threads);
+    resetWorld(world, seed);
+    if(net_role >= 0)
+    {
+      if(!netOpen(net, world, net_role, net_port, peer_host.c_str(), peer_port, seed))
+      {
+        cerr << "can't play over port " << net_port << " with " << peer_host << ":" << peer_port << endl;
+        return 1;
+      }
+      netplay = true;
+      cout << "\nWaiting for the other player on port " << net_port << endl;
+    }
+    if(watch_address)
+    {
+      string host;
+      int port;
+      if(!splitAddress(watch_address, host, port))
+      {
+        cerr << "--watch takes HOST:PORT" << endl;
+        return 1;
+      }
+      if(!watchMatch(spectator, host.c_str(), port, watch_match))
+      {
+        cerr << "can't watch match " << watch_match << " on " << watch_address << endl;
+        return 1;
+      }
+      watching = true;
+    }
+    if(feed_name)
+    {
+      feed = createFeed(feed_name);
+      if(!feed)
+      {
+        cerr << "can't create the feed " << feed_name << endl;
+        return 1;
+      }
+      atexit(stopBroadcast);
+    }
+    if(view_name)
+    {
+      viewed_feed = openFeed(view_name);
+      if(!viewed_feed)
+      {
+        cerr << "no feed " << view_name << "; start sample2D --broadcast " << view_name << " first" << endl;
+        return 1;
+      }
+    }
 
     GLFWwindow* window = initGLFW(width, height);
 
 	initGL (window, width, height);
 
     double last_update_time = glfwGetTime(), current_time;
-    cout<<"\nScore : "<<score<<"\nLife : "<<life<<endl;
-
-    mpg123_handle *mh;
-    unsigned char *buffer;
-    size_t buffer_size;
-    size_t done;
-    int err;
-
-    int driver;
-    ao_device *dev;
-
-    ao_sample_format format;
-    int channels, encoding;
-    long rate;
-
-    //if(argc < 2)
-    //    exit(0);
-
-    /* initializations */
-    ao_initialize();
-    driver = ao_default_driver_id();
-    mpg123_init();
-    mh = mpg123_new(NULL, &err);
-    buffer_size = 3000;
-    buffer = (unsigned char*) malloc(buffer_size * sizeof(unsigned char));
-
-    /* open the file and get the decoding format */
-    mpg123_open(mh, "spooky1.mp3");
-    mpg123_getformat(mh, &rate, &channels, &encoding);
-
-    /* set the output format and open the output device */
-    format.bits = mpg123_encsize(encoding) * BITS;
-    format.rate = rate;
-    format.channels = channels;
-    format.byte_format = AO_FMT_NATIVE;
-    format.matrix = 0;
-    dev = ao_open_live(driver, &format, NULL);
+    double previous_time = last_update_time, accumulator = 0;
+    int ticks_run = 0;
+    cout<<"\nScore : "<<world.score<<"\nLife : "<<world.life<<endl;
+
+    // Registered before the audio, so the last row comes after it stops
+    if(metrics_path)
+    {
+      if(!startMetrics(metrics_path))
+      {
+        cerr << "can't write the metrics to " << metrics_path << endl;
+        return 1;
+      }
+      atexit(stopMetrics);
+    }
+    // The game runs in real time, so a WAV keeps to it too
+    if(startAudio("spooky1.mp3", audio_backend, audio_file, true))
+      atexit(finishAudio);
+    else
+      cerr << "can't play spooky1.mp3; carrying on without music (--audio null needs no sound device)" << endl;
 
     /* Draw in loop */
     while (!glfwWindowShouldClose(window)) {
-        /* decode and play */
-          if (mpg123_read(mh, buffer, buffer_size, &done) == MPG123_OK)
-              ao_play(dev, (char *)buffer, done);
-          else mpg123_seek(mh, 0, SEEK_SET); // loop audio from start again if ended
+        // Run as many fixed ticks as real time calls for, whatever the render rate
+        current_time = glfwGetTime();
+        accumulator += min(current_time - previous_time, MAX_FRAME_TIME);
+        frameMetrics(current_time - previous_time, ticks_run);
+        previous_time = current_time;
+        if(netplay)
+            netReceive(net);
+        if(watching)
+        {
+            // The server runs the match; only the camera is ours
+            if(!receiveViews(spectator))
+            {
+                cout << "\nThe server went away\n";
+                glfwSetWindowShouldClose(window, true);
+            }
+            if(spectator.messages > 0)
+            {
+                showView(spectator.view, world);
+                reportShown(spectator.view.score, spectator.view.life, spectator.view.over);
+            }
+            for(; accumulator >= TICK; accumulator -= TICK)
+                viewInput(sampleInput(window));
+        }
+        if(viewed_feed)
+        {
+            // Another process runs the game; only the camera is ours
+            if(readFrame(viewed_feed, feed_seen, feed_frame, feed_retries))
+            {
+                showFrame(feed_frame, world);
+                reportShown(feed_frame.score, feed_frame.life, feed_frame.over);
+            }
+            for(; accumulator >= TICK; accumulator -= TICK)
+                viewInput(sampleInput(window));
+        }
+        while (accumulator >= TICK) {
+            // Too far ahead of the other player: wait for its input
+            if(netplay && !netCanAdvance(net))
+            {
+                accumulator = TICK;
+                break;
+            }
+            InputFrame input;
+            if(!replay_path)
+            {
+                input = sampleInput(window);
+            }
+            else if(!replayInput(replay, input))
+            {
+                cout << "\nEnd of the recording\n";
+                glfwSetWindowShouldClose(window, true);
+                break;
+            }
+            recordInput(recorder, input);
+            viewInput(input);
+            if(netplay)
+            {
+                netAdvance(net, input);
+                reportLocalEvents(world.events);
+            }
+            else
+            {
+                stepWorld(world, input);
+                reportEvents(world.events);
+            }
+            ticks_run++;
+            accumulator -= TICK;
+        }
+        if(netplay)
+        {
+            netSend(net);
+            final_events.clear();
+            netFinalEvents(net, final_events);
+            reportEvents(final_events, net.role == NET_SHOOTER);
+        }
+
+        if(feed)
+            publishFrame(feed, world, ticks_run, accumulator / TICK);
+
         // OpenGL Draw commands
-        draw(window);
+        draw(window, watching || viewed_feed ? 1 : accumulator / TICK);
 
         reshapeWindow (window, width, height);
 
@@ -1283,12 +1349,8 @@ int main (int argc, char** argv)
         }
     }
     /* clean up */
-    free(buffer);
-    ao_close(dev);
-    mpg123_close(mh);
-    mpg123_delete(mh);
-    mpg123_exit();
-    ao_shutdown();
+    stopRecording(recorder);
+    netFinish();
 
 
     glfwTerminate();
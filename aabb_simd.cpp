@@ -0,0 +1,90 @@
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define AABB_X86 1
+#endif
+
+#include "broadphase.h"
+#include "aabb_simd.h"
+
+#define AABB_PAD 1e-4f
+
+static unsigned bricksNearBox8Scalar (const float *x, const float *y, const float *e, float cx, float cy, float ex, float ey)
+{
+  unsigned mask = 0;
+  for(int k=0; k<8; k++)
+  {
+    if(e[k] == 1 && fabsf(x[k] - cx) <= BRICK_HALF_W+AABB_PAD+ex && fabsf(y[k] - cy) <= BRICK_HALF_H+AABB_PAD+ey)
+      mask |= 1u << k;
+  }
+  return mask;
+}
+
+#ifdef AABB_X86
+/* |centre - c| <= brick half extent + e on both axes, and alive; 4 bricks per call */
+__attribute__((target("sse2")))
+static unsigned bricksNearBox4Sse (const float *x, const float *y, const float *e, __m128 cx, __m128 cy, __m128 ex, __m128 ey)
+{
+  const __m128 sign = _mm_set1_ps(-0.0f);
+  __m128 dx = _mm_andnot_ps(sign, _mm_sub_ps(_mm_loadu_ps(x), cx));
+  __m128 dy = _mm_andnot_ps(sign, _mm_sub_ps(_mm_loadu_ps(y), cy));
+  __m128 in = _mm_and_ps(_mm_cmple_ps(dx, ex), _mm_cmple_ps(dy, ey));
+  in = _mm_and_ps(in, _mm_cmpeq_ps(_mm_loadu_ps(e), _mm_set1_ps(1.0f)));
+  return _mm_movemask_ps(in);
+}
+
+__attribute__((target("sse2")))
+static unsigned bricksNearBox8Sse (const float *x, const float *y, const float *e, float cx, float cy, float ex, float ey)
+{
+  __m128 vx = _mm_set1_ps(cx), vy = _mm_set1_ps(cy);
+  __m128 wx = _mm_set1_ps(BRICK_HALF_W+AABB_PAD+ex), wy = _mm_set1_ps(BRICK_HALF_H+AABB_PAD+ey);
+  return bricksNearBox4Sse(x, y, e, vx, vy, wx, wy) | (bricksNearBox4Sse(x+4, y+4, e+4, vx, vy, wx, wy) << 4);
+}
+
+__attribute__((target("avx2")))
+static unsigned bricksNearBox8Avx2 (const float *x, const float *y, const float *e, float cx, float cy, float ex, float ey)
+{
+  const __m256 sign = _mm256_set1_ps(-0.0f);
+  __m256 dx = _mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_loadu_ps(x), _mm256_set1_ps(cx)));
+  __m256 dy = _mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_loadu_ps(y), _mm256_set1_ps(cy)));
+  __m256 in = _mm256_and_ps(_mm256_cmp_ps(dx, _mm256_set1_ps(BRICK_HALF_W+AABB_PAD+ex), _CMP_LE_OQ),
+                            _mm256_cmp_ps(dy, _mm256_set1_ps(BRICK_HALF_H+AABB_PAD+ey), _CMP_LE_OQ));
+  in = _mm256_and_ps(in, _mm256_cmp_ps(_mm256_loadu_ps(e), _mm256_set1_ps(1.0f), _CMP_EQ_OQ));
+  return _mm256_movemask_ps(in);
+}
+#endif
+
+typedef unsigned (*BricksNearBox8Fn) (const float*, const float*, const float*, float, float, float, float);
+
+static const char *kernel_name = "scalar";
+
+static BricksNearBox8Fn pickKernel ()
+{
+#ifdef AABB_X86
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2"))
+  {
+    kernel_name = "avx2";
+    return bricksNearBox8Avx2;
+  }
+  if(__builtin_cpu_supports("sse2"))
+  {
+    kernel_name = "sse2";
+    return bricksNearBox8Sse;
+  }
+#endif
+  return bricksNearBox8Scalar;
+}
+
+static BricksNearBox8Fn kernel = pickKernel();
+
+unsigned bricksNearBox8 (const float *x, const float *y, const float *e, float cx, float cy, float ex, float ey)
+{
+  return kernel(x, y, e, cx, cy, ex, ey);
+}
+
+const char* bricksNearBoxKernel ()
+{
+  return kernel_name;
+}
@@ -0,0 +1,16 @@
+#ifndef AABB_SIMD_H
+#define AABB_SIMD_H
+
+/* Batch box-vs-brick test over the SoA brick columns.
+ * Returns a mask with bit k set when the box centred on (cx, cy) with half
+ * extents (ex, ey) may overlap live brick k of the 8 starting at x, y, e; a
+ * point query passes ex = ey = 0, a laser sweep passes its bounding box.
+ * The boxes are padded by a hair so the mask is a superset of the exact
+ * narrow phase, which still confirms each hit.
+ * The AVX2, SSE or scalar kernel is chosen at startup from the CPU. */
+unsigned bricksNearBox8 (const float *x, const float *y, const float *e, float cx, float cy, float ex, float ey);
+
+/* Name of the kernel bricksNearBox8 dispatches to */
+const char* bricksNearBoxKernel ();
+
+#endif
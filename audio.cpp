@@ -0,0 +1,400 @@
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ao/ao.h>
+#include <mpg123.h>
+#include "audio.h"
+#include "pcmring.h"
+#include "pcmcache.h"
+#include "mp3map.h"
+#include "mixer.h"
+
+using namespace std;
+
+#define BITS 8
+#define PERIOD_FRAMES 1024   // sample frames per ao_play()
+#define RING_PERIODS 24      // about half a second at 44.1 kHz
+
+static mpg123_handle *mh = NULL;   // only until the cache is there
+static long rate;
+static int channels, encoding;
+static int backend = AUDIO_LIVE;
+static bool flat_out = false;      // nothing paces the output
+static ao_device *dev = NULL;      // none for AUDIO_NULL
+static PcmRing ring;
+static size_t period_bytes, frame_bytes;
+static long period_us;
+static bool initialised = false;
+static thread decoder, player, cacher;
+static atomic<bool> running(false), stopping(false);
+// When nothing paces the threads, each waits here for the other, the
+// player for a block and the decoder for room
+static mutex fill_lock;
+static condition_variable ring_filled, ring_drained;
+
+// The MP3, mapped when it can be; the live decoder and cacher each read
+// it through a reader of their own
+static Mp3Map music;
+static Mp3Reader music_reader;
+
+// The decoded track, from the start or once cacher has built it
+static string mp3;
+static uint64_t mp3_hash;
+static PcmCache cache;
+static atomic<bool> cached(false);
+static bool registered = false;
+
+static atomic<long long> periods(0), underruns(0), silent_bytes(0), overruns(0);
+static AudioHistograms histograms;
+
+// Effects: queued by playSfx(), started and mixed by the output thread
+struct SfxTrigger {
+  int32_t sfx, spare;
+  int64_t queued_ns;       // steady clock
+  int64_t queued_frame;    // frames handed out by then
+};
+#define TRIGGERS 64        // queued at most between two blocks
+
+static PcmRing triggers;
+static Mixer mixer;
+static atomic<int> voices_playing(0);
+static atomic<long long> sfx_played(0), sfx_stolen(0), sfx_dropped(0);
+static atomic<long long> mix_ns(0), mix_ns_max(0), slow_mixes(0);
+
+static int64_t nowNs ()
+{
+  return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void buildCache ()
+{
+  PcmCache built;
+  if(buildPcmCache(mp3.c_str(), music, mp3_hash, stopping) && openPcmCache(mp3.c_str(), mp3_hash, built))
+  {
+    if(built.rate == rate && built.channels == channels && built.encoding == encoding)
+    {
+      cache = built;
+      cached.store(true, memory_order_release);
+    }
+    else
+      closePcmCache(built);
+  }
+}
+
+static void decode ()
+{
+  vector<unsigned char> chunk(period_bytes);
+  const unsigned char *pending = NULL;
+  size_t left = 0;          // bytes at pending not yet in the ring
+  size_t position = 0;      // bytes into the track
+  while(running.load(memory_order_relaxed))
+  {
+    if(left == 0)
+    {
+      if(cached.load(memory_order_acquire))
+      {
+        // Straight from the mapping, picking up where decoding got to
+        position %= cache.bytes;
+        pending = cache.pcm + position;
+        left = min(period_bytes, cache.bytes - position);
+      }
+      else
+      {
+        size_t done = 0;
+        int64_t start = nowNs();
+        int err = mpg123_read(mh, &chunk[0], chunk.size(), &done);
+        addSample(histograms.decode_ns, nowNs() - start);
+        if(done == 0 && err != MPG123_OK && err != MPG123_NEW_FORMAT)
+        {
+          mpg123_seek(mh, 0, SEEK_SET);  // loop audio from start again if ended
+          position = 0;
+        }
+        pending = &chunk[0];
+        left = done;
+      }
+      continue;
+    }
+    size_t wrote;
+    if(flat_out)
+    {
+      // Under the lock, so the player can't test the ring between the
+      // write and the notify and then sleep through it
+      lock_guard<mutex> guard(fill_lock);
+      wrote = writeRing(ring, pending, left);
+      ring_filled.notify_one();
+    }
+    else
+      wrote = writeRing(ring, pending, left);
+    pending += wrote;
+    left -= wrote;
+    position += wrote;
+    if(left > 0)
+    {
+      // The ring is full: it holds plenty, so nap for part of a period
+      overruns.fetch_add(1, memory_order_relaxed);
+      if(flat_out)
+      {
+        unique_lock<mutex> guard(fill_lock);
+        ring_drained.wait(guard, [left] { return !running.load(memory_order_relaxed) || ringRoom(ring) >= left; });
+      }
+      else
+        this_thread::sleep_for(chrono::microseconds(period_us / 4));
+    }
+  }
+}
+
+static void play ()
+{
+  vector<unsigned char> chunk(period_bytes);
+  // Let the decoder get ahead before the device starts asking
+  while(running.load(memory_order_relaxed) && ringFilled(ring) < ring.data.size() / 2)
+    this_thread::sleep_for(chrono::milliseconds(1));
+  auto deadline = chrono::steady_clock::now();
+  while(running.load(memory_order_relaxed))
+  {
+    // Nothing plays in real time without a device or a clock, so wait for
+    // the decoder rather than pad with silence
+    if(flat_out)
+    {
+      unique_lock<mutex> guard(fill_lock);
+      ring_filled.wait(guard, [] { return !running.load(memory_order_relaxed) || ringFilled(ring) >= period_bytes; });
+      if(!running.load(memory_order_relaxed))
+        break;
+    }
+    size_t filled = ringFilled(ring);
+    addSample(histograms.fill_percent, filled * 100 / ring.data.size());
+    size_t want = min(filled, period_bytes) / frame_bytes * frame_bytes;
+    size_t got;
+    if(flat_out)
+    {
+      lock_guard<mutex> guard(fill_lock);
+      got = readRing(ring, &chunk[0], want);
+      ring_drained.notify_one();
+    }
+    else
+      got = readRing(ring, &chunk[0], want);
+    if(got < period_bytes)
+    {
+      memset(&chunk[got], 0, period_bytes - got);
+      underruns.fetch_add(1, memory_order_relaxed);
+      silent_bytes.fetch_add(period_bytes - got, memory_order_relaxed);
+    }
+
+    // Effects start on a block boundary, so one lands at most a block late
+    int64_t mix_start = nowNs();
+    SfxTrigger started[TRIGGERS];
+    int starts = readRing(triggers, (unsigned char*)started, sizeof(started)) / sizeof(SfxTrigger);
+    for(int k=0; k<starts; k++)
+      startVoice(mixer, started[k].sfx);
+    int playing = mixVoices(mixer, (int16_t*)&chunk[0], period_bytes / sizeof(int16_t));
+    int64_t took = nowNs() - mix_start;
+    voices_playing.store(playing, memory_order_relaxed);
+    sfx_played.store(mixer.started, memory_order_relaxed);
+    sfx_stolen.store(mixer.stolen, memory_order_relaxed);
+    addSample(histograms.mix_ns, took);
+    mix_ns.fetch_add(took, memory_order_relaxed);
+    if(took > mix_ns_max.load(memory_order_relaxed))
+      mix_ns_max.store(took, memory_order_relaxed);
+    if(took * 10 > period_us * 1000)
+      slow_mixes.fetch_add(1, memory_order_relaxed);
+
+    if(dev)
+    {
+      int64_t play_start = nowNs();
+      ao_play(dev, (char*)&chunk[0], period_bytes);
+      addSample(histograms.play_ns, nowNs() - play_start);
+    }
+    // Flat out, the wall clock says nothing about when a block is heard,
+    // so an effect is as late as the frames between its queueing and the
+    // start of its block
+    int64_t taken = nowNs();
+    long long block = periods.load(memory_order_relaxed);
+    for(int k=0; k<starts; k++)
+      addSample(histograms.latency_ns, flat_out ? (block * PERIOD_FRAMES - started[k].queued_frame) * 1000000000LL / rate :
+                                                  taken - started[k].queued_ns);
+    if(backend == AUDIO_WAV && !flat_out)
+    {
+      // A file takes blocks as fast as they come; keep to the pace of a
+      // device, so the effects land where they were heard
+      deadline += chrono::microseconds(period_us);
+      this_thread::sleep_until(deadline);
+    }
+    periods.fetch_add(1, memory_order_relaxed);
+  }
+}
+
+int parseAudioBackend (const char *name)
+{
+  if(strcmp(name, "live") == 0)
+    return AUDIO_LIVE;
+  if(strcmp(name, "wav") == 0)
+    return AUDIO_WAV;
+  if(strcmp(name, "null") == 0)
+    return AUDIO_NULL;
+  return -1;
+}
+
+bool startAudio (const char *path, int output, const char *wav_path, bool paced)
+{
+  if(running)
+    return true;
+  ao_initialize();
+  mpg123_init();
+  initialised = true;
+  stopping = false;
+  mp3 = path;
+  mp3_hash = mapMp3(path, music) ? hashBytes(music.data, music.size) : 0;
+  if(mp3_hash != 0 && openPcmCache(path, mp3_hash, cache))
+  {
+    rate = cache.rate;
+    channels = cache.channels;
+    encoding = cache.encoding;
+    cached = true;
+    unmapMp3(music);  // nothing decodes it this run
+  }
+  else
+  {
+    int err;
+    mh = mpg123_new(NULL, &err);
+    // Straight out of the mapping, without a read() per chunk
+    if(!mh || (music.data ? openMappedMp3(mh, music, music_reader) : mpg123_open(mh, path)) != MPG123_OK || mpg123_getformat(mh, &rate, &channels, &encoding) != MPG123_OK)
+    {
+      stopAudio();
+      return false;
+    }
+    // Hold the rate and channels mpg123 reports, so a stream that changes
+    // them midway is converted rather than played wrong, and take 16 bit
+    // samples, which is what the mixer adds effects to
+    encoding = MPG123_ENC_SIGNED_16;
+    mpg123_format_none(mh);
+    mpg123_format(mh, rate, channels, encoding);
+  }
+
+  /* set the output format and open the output device */
+  ao_sample_format format;
+  memset(&format, 0, sizeof(format));
+  format.bits = mpg123_encsize(encoding) * BITS;
+  format.rate = rate;
+  format.channels = channels;
+  format.byte_format = AO_FMT_NATIVE;
+  format.matrix = 0;
+  backend = output;
+  flat_out = backend == AUDIO_NULL || (backend == AUDIO_WAV && !paced);
+  if(backend == AUDIO_LIVE)
+    dev = ao_open_live(ao_default_driver_id(), &format, NULL);
+  else if(backend == AUDIO_WAV)
+    dev = ao_open_file(ao_driver_id("wav"), wav_path, 1, &format, NULL);
+  if(!dev && backend != AUDIO_NULL)
+  {
+    stopAudio();
+    return false;
+  }
+
+  frame_bytes = mpg123_encsize(encoding) * channels;
+  period_bytes = PERIOD_FRAMES * frame_bytes;
+  period_us = PERIOD_FRAMES * 1000000LL / rate;
+  initRing(ring, RING_PERIODS * period_bytes);
+  initRing(triggers, TRIGGERS * sizeof(SfxTrigger));
+  initMixer(mixer, rate, channels);
+  running = true;
+  decoder = thread(decode);
+  player = thread(play);
+  if(!cached && mp3_hash != 0)
+    cacher = thread(buildCache);  // decoding goes on live until it is done
+  if(!registered)
+  {
+    atexit(stopAudio);
+    registered = true;
+  }
+  return true;
+}
+
+void playSfx (int sfx)
+{
+  if(!running.load(memory_order_relaxed))
+    return;
+  SfxTrigger trigger;
+  trigger.sfx = sfx;
+  trigger.spare = 0;
+  trigger.queued_ns = nowNs();
+  trigger.queued_frame = periods.load(memory_order_relaxed) * PERIOD_FRAMES;
+  // Whole triggers only, so the output thread never reads half of one
+  if(ringRoom(triggers) >= sizeof(trigger))
+    writeRing(triggers, (const unsigned char*)&trigger, sizeof(trigger));
+  else
+    sfx_dropped.fetch_add(1, memory_order_relaxed);
+}
+
+void drainAudio (int max_ms)
+{
+  auto until = chrono::steady_clock::now() + chrono::milliseconds(max_ms);
+  while(running.load(memory_order_relaxed) && (ringFilled(triggers) > 0 || voices_playing.load(memory_order_relaxed) > 0) &&
+        chrono::steady_clock::now() < until)
+    this_thread::sleep_for(chrono::milliseconds(5));
+}
+
+void stopAudio ()
+{
+  {
+    // Under the lock, so neither thread misses it between its test and
+    // its wait
+    lock_guard<mutex> guard(fill_lock);
+    running = false;
+  }
+  stopping = true;
+  ring_filled.notify_all();
+  ring_drained.notify_all();
+  if(cacher.joinable())
+    cacher.join();
+  if(decoder.joinable())
+    decoder.join();
+  if(player.joinable())
+    player.join();
+  if(dev)
+    ao_close(dev);
+  if(mh)
+  {
+    mpg123_close(mh);
+    mpg123_delete(mh);
+  }
+  closePcmCache(cache);
+  cached = false;
+  unmapMp3(music);
+  if(initialised)
+  {
+    mpg123_exit();
+    ao_shutdown();
+  }
+  dev = NULL;
+  mh = NULL;
+  initialised = false;
+}
+
+AudioCounters audioCounters ()
+{
+  AudioCounters counters;
+  counters.periods = periods.load(memory_order_relaxed);
+  counters.underruns = underruns.load(memory_order_relaxed);
+  counters.silent_bytes = silent_bytes.load(memory_order_relaxed);
+  counters.overruns = overruns.load(memory_order_relaxed);
+  counters.sfx_played = sfx_played.load(memory_order_relaxed);
+  counters.sfx_stolen = sfx_stolen.load(memory_order_relaxed);
+  counters.sfx_dropped = sfx_dropped.load(memory_order_relaxed);
+  counters.mix_ns = mix_ns.load(memory_order_relaxed);
+  counters.mix_ns_max = mix_ns_max.load(memory_order_relaxed);
+  counters.slow_mixes = slow_mixes.load(memory_order_relaxed);
+  counters.period_ns = period_us * 1000LL;
+  return counters;
+}
+
+const AudioHistograms &audioHistograms ()
+{
+  return histograms;
+}
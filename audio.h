@@ -0,0 +1,67 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include "histogram.h"
+
+/* Background music, off the render thread. One thread decodes the MP3
+ * into a ring of PCM (pcmring.h) and another feeds the ring to the sound
+ * device, so ao_play() blocking on the device never holds up a frame, and
+ * a slow frame never starves the device as long as the ring lasts. When
+ * it doesn't, the device gets silence and the underrun is counted.
+ * Sound effects (mixer.h) are mixed in by the output thread, block by
+ * block, and the time that takes is measured against the block. */
+
+struct AudioCounters {
+  long long periods;        // periods handed to the device
+  long long underruns;      // periods the ring couldn't fill
+  long long silent_bytes;   // zeros played in their place
+  long long overruns;       // times the decoder found the ring full and waited
+  long long sfx_played, sfx_stolen, sfx_dropped;  // dropped: queue full
+  long long mix_ns, mix_ns_max;  // mixing effects in, in all and at worst
+  long long slow_mixes;     // blocks whose mixing took over a tenth of the block
+  long long period_ns;      // one block's worth of sound
+};
+
+/* Where the sound goes */
+enum AudioBackend {
+  AUDIO_LIVE,   // the default libao device
+  AUDIO_WAV,    // a WAV file, at the pace of a device if asked to be,
+                // else as fast as it decodes and mixes
+  AUDIO_NULL    // nowhere, as fast as it decodes and mixes
+};
+
+/* AUDIO_* from "live", "wav" or "null"; -1 for anything else */
+int parseAudioBackend (const char *name);
+
+/* Start looping the MP3 at path into output (an AudioBackend), writing
+ * wav_path for AUDIO_WAV, paced like a device if the game is played in
+ * real time; false, and no threads, if the MP3 or the output can't be
+ * opened */
+bool startAudio (const char *path, int output, const char *wav_path, bool paced);
+
+/* Queue an effect (an SfxId) for the next block; from one thread only,
+ * and nothing happens if there is no audio */
+void playSfx (int sfx);
+
+/* Wait up to max_ms for queued and playing effects to finish */
+void drainAudio (int max_ms);
+
+/* Stop and join both threads and close the device; safe to call again */
+void stopAudio ();
+
+AudioCounters audioCounters ();
+
+/* Where the time goes, block by block */
+struct AudioHistograms {
+  Histogram decode_ns;     // one mpg123_read(); none once the cache plays
+  Histogram fill_percent;  // how full the ring was as each block was taken
+  Histogram mix_ns;        // mixing the effects into a block
+  Histogram play_ns;       // ao_play() holding the output thread
+  Histogram latency_ns;    // from playSfx() to the device taking the
+                           // block the effect starts in; flat out, the
+                           // sound between them instead
+};
+
+const AudioHistograms &audioHistograms ();
+
+#endif
@@ -0,0 +1,418 @@
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BATCH_X86 1
+#endif
+
+#include "batch.h"
+#include "world.h"
+#include "controls.h"
+#include "jobs.h"
+
+using namespace std;
+
+/* Games per job */
+#define GAME_GRAIN 16
+
+/* Each game's bricks and lasers live in its World; its scalars live here,
+ * one column per scalar across the games, and a tick moves them for a
+ * job's games in one SIMD pass, the AVX2, SSE2 or scalar kernel chosen at
+ * startup from the CPU. The kernels round as controls.h does, so a batch
+ * game plays as stepWorld() would play it. Only stepField() goes game by
+ * game: the baskets are written into the World before it, for the
+ * catches, and the score and life read back after. The World's other
+ * scalars go unused. */
+struct Batch {
+  int games, max_ticks;
+  uint64_t seed;
+  vector<World> worlds;
+  vector<int> ticks;   // ticks into each game
+  vector<int> lowest;  // bricks below this index have left the field
+  // Scalars of every game
+  vector<float> q1, q2, q3, angle, fall_step;
+  vector<int> ct, delay, score, life;
+  // What this tick's pass decided for each game's stepField()
+  vector<int> spawn, fire;             // 0 or 1
+  vector<float> fire_q3, fire_angle;  // the shooter as it fired, before the clamps
+  // The buffers of the call in progress
+  const unsigned *actions;
+  float *observations, *rewards;
+  unsigned char *dones;
+};
+
+/* The scalar half of stepWorld() for games [first, last), down the
+ * columns; also the tail of the SIMD kernels */
+static void moveScalarsScalar (Batch &batch, int first, int last)
+{
+  for(int g=first; g<last; g++)
+  {
+    unsigned a = batch.actions[g];
+    float shooter = stepControl(batch.q3[g], actionBit(a, INPUT_SHOOTER_UP), actionBit(a, INPUT_SHOOTER_DOWN), 0.2);
+    float heading = stepControl(batch.angle[g], actionBit(a, INPUT_AIM_UP), actionBit(a, INPUT_AIM_DOWN), 5);
+    batch.fire_q3[g] = shooter;
+    batch.fire_angle[g] = heading;
+    batch.q1[g] = clampControl(stepControl(batch.q1[g], actionBit(a, INPUT_RED_RIGHT), actionBit(a, INPUT_RED_LEFT), 0.2),
+                               -2, 3.5, -2, 0.2);
+    batch.q2[g] = clampControl(stepControl(batch.q2[g], actionBit(a, INPUT_GREEN_RIGHT), actionBit(a, INPUT_GREEN_LEFT), 0.2),
+                               2, 3.5, -2, 0.2);
+    batch.q3[g] = clampControl(shooter, 0, 3.75, -3.75, 0.2);
+    batch.angle[g] = clampControl(heading, 0, 80, -80, 5);
+    int since_brick = batch.ct[g] + 1;
+    batch.spawn[g] = since_brick == SPAWN_TICKS;
+    batch.ct[g] = since_brick == SPAWN_TICKS ? 0 : since_brick;
+    int since_shot = batch.delay[g] + 1;
+    bool shot = actionBit(a, INPUT_FIRE) && since_shot >= FIRE_TICKS;
+    batch.fire[g] = shot;
+    batch.delay[g] = shot ? 0 : since_shot;
+    batch.fall_step[g] = fallStep(a);
+  }
+}
+
+#ifdef BATCH_X86
+/* Lanes whose actions have bit action set */
+__attribute__((target("sse2")))
+static inline __m128 actionMaskSse (__m128i actions, int action)
+{
+  __m128i bit = _mm_set1_epi32(1 << action);
+  return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(actions, bit), bit));
+}
+
+__attribute__((target("sse2")))
+static inline __m128 selectSse (__m128 mask, __m128 yes, __m128 no)
+{
+  return _mm_or_ps(_mm_and_ps(mask, yes), _mm_andnot_ps(mask, no));
+}
+
+/* (float)(value + step) in each lane, the sum in double */
+__attribute__((target("sse2")))
+static inline __m128 addDoubleSse (__m128 value, double step)
+{
+  __m128d d = _mm_set1_pd(step);
+  __m128d lo = _mm_add_pd(_mm_cvtps_pd(value), d);
+  __m128d hi = _mm_add_pd(_mm_cvtps_pd(_mm_movehl_ps(value, value)), d);
+  return _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi));
+}
+
+__attribute__((target("sse2")))
+static inline __m128 stepControlSse (__m128 value, __m128 up, __m128 down, double step)
+{
+  value = selectSse(up, addDoubleSse(value, step), value);
+  return selectSse(down, addDoubleSse(value, -step), value);
+}
+
+__attribute__((target("sse2")))
+static inline __m128 clampControlSse (__m128 value, float offset, float hi, float lo, double step)
+{
+  __m128 off = _mm_set1_ps(offset);
+  value = selectSse(_mm_cmpge_ps(_mm_add_ps(value, off), _mm_set1_ps(hi)), addDoubleSse(value, -step), value);
+  return selectSse(_mm_cmple_ps(_mm_add_ps(value, off), _mm_set1_ps(lo)), addDoubleSse(value, step), value);
+}
+
+/* 4 games at a time */
+__attribute__((target("sse2")))
+static void moveScalarsSse (Batch &batch, int first, int last)
+{
+  const __m128i one = _mm_set1_epi32(1);
+  int g = first;
+  for(; g+4 <= last; g+=4)
+  {
+    __m128i a = _mm_loadu_si128((const __m128i*)(batch.actions + g));
+    __m128 shooter = stepControlSse(_mm_loadu_ps(&batch.q3[g]), actionMaskSse(a, INPUT_SHOOTER_UP),
+                                    actionMaskSse(a, INPUT_SHOOTER_DOWN), 0.2);
+    __m128 heading = stepControlSse(_mm_loadu_ps(&batch.angle[g]), actionMaskSse(a, INPUT_AIM_UP),
+                                    actionMaskSse(a, INPUT_AIM_DOWN), 5);
+    _mm_storeu_ps(&batch.fire_q3[g], shooter);
+    _mm_storeu_ps(&batch.fire_angle[g], heading);
+    __m128 red = stepControlSse(_mm_loadu_ps(&batch.q1[g]), actionMaskSse(a, INPUT_RED_RIGHT),
+                                actionMaskSse(a, INPUT_RED_LEFT), 0.2);
+    __m128 green = stepControlSse(_mm_loadu_ps(&batch.q2[g]), actionMaskSse(a, INPUT_GREEN_RIGHT),
+                                  actionMaskSse(a, INPUT_GREEN_LEFT), 0.2);
+    _mm_storeu_ps(&batch.q1[g], clampControlSse(red, -2, 3.5, -2, 0.2));
+    _mm_storeu_ps(&batch.q2[g], clampControlSse(green, 2, 3.5, -2, 0.2));
+    _mm_storeu_ps(&batch.q3[g], clampControlSse(shooter, 0, 3.75, -3.75, 0.2));
+    _mm_storeu_ps(&batch.angle[g], clampControlSse(heading, 0, 80, -80, 5));
+
+    __m128i since_brick = _mm_add_epi32(_mm_loadu_si128((const __m128i*)&batch.ct[g]), one);
+    __m128i spawn = _mm_cmpeq_epi32(since_brick, _mm_set1_epi32(SPAWN_TICKS));
+    _mm_storeu_si128((__m128i*)&batch.spawn[g], _mm_and_si128(spawn, one));
+    _mm_storeu_si128((__m128i*)&batch.ct[g], _mm_andnot_si128(spawn, since_brick));
+    __m128i since_shot = _mm_add_epi32(_mm_loadu_si128((const __m128i*)&batch.delay[g]), one);
+    __m128i shot = _mm_and_si128(_mm_castps_si128(actionMaskSse(a, INPUT_FIRE)),
+                                 _mm_cmpgt_epi32(since_shot, _mm_set1_epi32(FIRE_TICKS - 1)));
+    _mm_storeu_si128((__m128i*)&batch.fire[g], _mm_and_si128(shot, one));
+    _mm_storeu_si128((__m128i*)&batch.delay[g], _mm_andnot_si128(shot, since_shot));
+
+    __m128 fall = selectSse(actionMaskSse(a, INPUT_FALL_SLOW), _mm_set1_ps(0.002f), _mm_set1_ps(0.007f));
+    _mm_storeu_ps(&batch.fall_step[g], selectSse(actionMaskSse(a, INPUT_FALL_FAST), _mm_set1_ps(0.1f), fall));
+  }
+  moveScalarsScalar(batch, g, last);
+}
+
+__attribute__((target("avx2")))
+static inline __m256 actionMaskAvx2 (__m256i actions, int action)
+{
+  __m256i bit = _mm256_set1_epi32(1 << action);
+  return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(actions, bit), bit));
+}
+
+__attribute__((target("avx2")))
+static inline __m256 addDoubleAvx2 (__m256 value, double step)
+{
+  __m256d d = _mm256_set1_pd(step);
+  __m128 lo = _mm256_cvtpd_ps(_mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(value)), d));
+  __m128 hi = _mm256_cvtpd_ps(_mm256_add_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(value, 1)), d));
+  return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+}
+
+__attribute__((target("avx2")))
+static inline __m256 stepControlAvx2 (__m256 value, __m256 up, __m256 down, double step)
+{
+  value = _mm256_blendv_ps(value, addDoubleAvx2(value, step), up);
+  return _mm256_blendv_ps(value, addDoubleAvx2(value, -step), down);
+}
+
+__attribute__((target("avx2")))
+static inline __m256 clampControlAvx2 (__m256 value, float offset, float hi, float lo, double step)
+{
+  __m256 off = _mm256_set1_ps(offset);
+  __m256 high = _mm256_cmp_ps(_mm256_add_ps(value, off), _mm256_set1_ps(hi), _CMP_GE_OQ);
+  value = _mm256_blendv_ps(value, addDoubleAvx2(value, -step), high);
+  __m256 low = _mm256_cmp_ps(_mm256_add_ps(value, off), _mm256_set1_ps(lo), _CMP_LE_OQ);
+  return _mm256_blendv_ps(value, addDoubleAvx2(value, step), low);
+}
+
+/* 8 games at a time */
+__attribute__((target("avx2")))
+static void moveScalarsAvx2 (Batch &batch, int first, int last)
+{
+  const __m256i one = _mm256_set1_epi32(1);
+  int g = first;
+  for(; g+8 <= last; g+=8)
+  {
+    __m256i a = _mm256_loadu_si256((const __m256i*)(batch.actions + g));
+    __m256 shooter = stepControlAvx2(_mm256_loadu_ps(&batch.q3[g]), actionMaskAvx2(a, INPUT_SHOOTER_UP),
+                                     actionMaskAvx2(a, INPUT_SHOOTER_DOWN), 0.2);
+    __m256 heading = stepControlAvx2(_mm256_loadu_ps(&batch.angle[g]), actionMaskAvx2(a, INPUT_AIM_UP),
+                                     actionMaskAvx2(a, INPUT_AIM_DOWN), 5);
+    _mm256_storeu_ps(&batch.fire_q3[g], shooter);
+    _mm256_storeu_ps(&batch.fire_angle[g], heading);
+    __m256 red = stepControlAvx2(_mm256_loadu_ps(&batch.q1[g]), actionMaskAvx2(a, INPUT_RED_RIGHT),
+                                 actionMaskAvx2(a, INPUT_RED_LEFT), 0.2);
+    __m256 green = stepControlAvx2(_mm256_loadu_ps(&batch.q2[g]), actionMaskAvx2(a, INPUT_GREEN_RIGHT),
+                                   actionMaskAvx2(a, INPUT_GREEN_LEFT), 0.2);
+    _mm256_storeu_ps(&batch.q1[g], clampControlAvx2(red, -2, 3.5, -2, 0.2));
+    _mm256_storeu_ps(&batch.q2[g], clampControlAvx2(green, 2, 3.5, -2, 0.2));
+    _mm256_storeu_ps(&batch.q3[g], clampControlAvx2(shooter, 0, 3.75, -3.75, 0.2));
+    _mm256_storeu_ps(&batch.angle[g], clampControlAvx2(heading, 0, 80, -80, 5));
+
+    __m256i since_brick = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)&batch.ct[g]), one);
+    __m256i spawn = _mm256_cmpeq_epi32(since_brick, _mm256_set1_epi32(SPAWN_TICKS));
+    _mm256_storeu_si256((__m256i*)&batch.spawn[g], _mm256_and_si256(spawn, one));
+    _mm256_storeu_si256((__m256i*)&batch.ct[g], _mm256_andnot_si256(spawn, since_brick));
+    __m256i since_shot = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)&batch.delay[g]), one);
+    __m256i shot = _mm256_and_si256(_mm256_castps_si256(actionMaskAvx2(a, INPUT_FIRE)),
+                                    _mm256_cmpgt_epi32(since_shot, _mm256_set1_epi32(FIRE_TICKS - 1)));
+    _mm256_storeu_si256((__m256i*)&batch.fire[g], _mm256_and_si256(shot, one));
+    _mm256_storeu_si256((__m256i*)&batch.delay[g], _mm256_andnot_si256(shot, since_shot));
+
+    __m256 fall = _mm256_blendv_ps(_mm256_set1_ps(0.007f), _mm256_set1_ps(0.002f), actionMaskAvx2(a, INPUT_FALL_SLOW));
+    _mm256_storeu_ps(&batch.fall_step[g], _mm256_blendv_ps(fall, _mm256_set1_ps(0.1f), actionMaskAvx2(a, INPUT_FALL_FAST)));
+  }
+  moveScalarsScalar(batch, g, last);
+}
+#endif
+
+typedef void (*MoveScalarsFn) (Batch &batch, int first, int last);
+
+static const char *kernel_name = "scalar";
+
+static MoveScalarsFn pickKernel ()
+{
+#ifdef BATCH_X86
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2"))
+  {
+    kernel_name = "avx2";
+    return moveScalarsAvx2;
+  }
+  if(__builtin_cpu_supports("sse2"))
+  {
+    kernel_name = "sse2";
+    return moveScalarsSse;
+  }
+#endif
+  return moveScalarsScalar;
+}
+
+static MoveScalarsFn moveScalars = pickKernel();
+
+/* Fill the scalar features of games [first, last), each a copy of a column */
+static void observeScalars (Batch &batch, int first, int last)
+{
+  float *__restrict obs = batch.observations;
+  const float *__restrict q1 = batch.q1.data();
+  const float *__restrict q2 = batch.q2.data();
+  const float *__restrict q3 = batch.q3.data();
+  const float *__restrict angle = batch.angle.data();
+  const float *__restrict fall_step = batch.fall_step.data();
+  const int *__restrict score = batch.score.data();
+  const int *__restrict life = batch.life.data();
+  int stride = batch.games;
+  for(int g=first; g<last; g++)
+  {
+    obs[OBS_RED*stride + g] = q1[g];
+    obs[OBS_GREEN*stride + g] = q2[g];
+    obs[OBS_SHOOTER*stride + g] = q3[g];
+    obs[OBS_ANGLE*stride + g] = angle[g];
+    obs[OBS_SCORE*stride + g] = score[g];
+    obs[OBS_LIFE*stride + g] = life[g];
+    obs[OBS_FALL*stride + g] = fall_step[g];
+  }
+}
+
+/* Fill game g's bricks in the observation buffer */
+static void observeBricks (Batch &batch, int g)
+{
+  World &world = batch.worlds[g];
+  float *obs = batch.observations + g;
+  int stride = batch.games;
+
+  // Every brick falls at the same speed from the same height, so index
+  // order is height order and the lowest live bricks come first
+  int &w = batch.lowest[g];
+  while(w < world.n && (world.e[w] != 1 || world.y[w] < -4))
+    w++;
+  int slot = 0;
+  for(int k=w; k<world.n && slot<BATCH_BRICKS; k++)
+  {
+    if(world.e[k] == 1)
+    {
+      obs[(OBS_BRICKS + 3*slot)*stride] = world.x[k];
+      obs[(OBS_BRICKS + 3*slot + 1)*stride] = world.y[k];
+      obs[(OBS_BRICKS + 3*slot + 2)*stride] = world.z[k];
+      slot++;
+    }
+  }
+  for(; slot<BATCH_BRICKS; slot++)
+  {
+    obs[(OBS_BRICKS + 3*slot)*stride] = 0;
+    obs[(OBS_BRICKS + 3*slot + 1)*stride] = 0;
+    obs[(OBS_BRICKS + 3*slot + 2)*stride] = -1;
+  }
+}
+
+/* Start game g over, its scalars as resetWorld() leaves them */
+static void startGame (Batch &batch, int g, uint64_t seed)
+{
+  World &world = batch.worlds[g];
+  resetWorld(world, seed);
+  batch.ticks[g] = 0;
+  batch.lowest[g] = 0;
+  batch.q1[g] = world.q1;
+  batch.q2[g] = world.q2;
+  batch.q3[g] = world.q3;
+  batch.angle[g] = world.angle;
+  batch.fall_step[g] = world.fall_step;
+  batch.ct[g] = world.ct;
+  batch.delay[g] = world.delay;
+  batch.score[g] = world.score;
+  batch.life[g] = world.life;
+}
+
+static void resetGames (int first, int last, int chunk, void *ctx)
+{
+  Batch &batch = *(Batch*)ctx;
+  for(int g=first; g<last; g++)
+  {
+    startGame(batch, g, batch.seed + g);
+    observeBricks(batch, g);
+  }
+  observeScalars(batch, first, last);
+}
+
+static void stepGames (int first, int last, int chunk, void *ctx)
+{
+  Batch &batch = *(Batch*)ctx;
+  moveScalars(batch, first, last);
+  for(int g=first; g<last; g++)
+  {
+    World &world = batch.worlds[g];
+    world.q1 = batch.q1[g];
+    world.q2 = batch.q2[g];
+    float fire_y = batch.fire[g] ? fireHeight(batch.fire_q3[g], batch.fire_angle[g]) : 0;
+    stepField(world, batch.spawn[g], batch.fire[g], fire_y, batch.fire_angle[g], batch.fall_step[g]);
+    batch.rewards[g] = world.score - batch.score[g];
+    batch.score[g] = world.score;
+    batch.life[g] = world.life;
+    batch.ticks[g]++;
+    bool done = world.over || batch.ticks[g] >= batch.max_ticks;
+    batch.dones[g] = done;
+    if(done)
+    {
+      startGame(batch, g, nextRng(world.rng));
+    }
+    observeBricks(batch, g);
+  }
+  observeScalars(batch, first, last);
+}
+
+const char* batchKernel ()
+{
+  return kernel_name;
+}
+
+Batch* batchCreate (int games, int max_ticks, int threads, uint64_t seed)
+{
+  // The pool is process wide: a program that already runs one, or an
+  // earlier batch, keeps its threads
+  if(!jobsRunning())
+    startJobs(threads);
+  Batch *batch = new Batch;
+  batch->games = games;
+  batch->max_ticks = max_ticks;
+  batch->seed = seed;
+  batch->worlds.resize(games);
+  batch->ticks.assign(games, 0);
+  batch->lowest.assign(games, 0);
+  batch->q1.assign(games, 0);
+  batch->q2.assign(games, 0);
+  batch->q3.assign(games, 0);
+  batch->angle.assign(games, 0);
+  batch->fall_step.assign(games, 0);
+  batch->ct.assign(games, 0);
+  batch->delay.assign(games, 0);
+  batch->score.assign(games, 0);
+  batch->life.assign(games, 0);
+  batch->spawn.assign(games, 0);
+  batch->fire.assign(games, 0);
+  batch->fire_q3.assign(games, 0);
+  batch->fire_angle.assign(games, 0);
+  // A brick every 90 ticks and a shot every 60 at most
+  for(int g=0; g<games; g++)
+  {
+    batch->worlds[g].parallel = false;
+    reserveWorld(batch->worlds[g], max_ticks/SPAWN_TICKS + 1, max_ticks/FIRE_TICKS + 1);
+  }
+  return batch;
+}
+
+void batchDestroy (Batch *batch)
+{
+  delete batch;
+}
+
+void batchReset (Batch *batch, float *observations)
+{
+  batch->observations = observations;
+  parallelFor(batch->games, GAME_GRAIN, resetGames, batch);
+}
+
+void batchStep (Batch *batch, const unsigned *actions, float *observations, float *rewards, unsigned char *dones)
+{
+  batch->actions = actions;
+  batch->observations = observations;
+  batch->rewards = rewards;
+  batch->dones = dones;
+  parallelFor(batch->games, GAME_GRAIN, stepGames, batch);
+}
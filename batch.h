@@ -0,0 +1,63 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+/* Many independent games stepped together, for agents that need a lot of
+ * rollouts. Plain C, so it can be loaded from other languages.
+ *
+ * The buffers are laid out structure-of-arrays across the games: feature f
+ * of game g is at [f*games + g], so one feature of every game is contiguous.
+ * Stepping does no allocation once every game has seen its largest field. */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Lowest live bricks on screen reported per game, oldest first */
+#define BATCH_BRICKS 8
+
+/* Observation features; each brick adds x, y and colour (-1 for an empty
+ * slot) starting at OBS_BRICKS */
+enum BatchFeature {
+  OBS_RED,       // red basket offset
+  OBS_GREEN,     // green basket offset
+  OBS_SHOOTER,   // shooter height
+  OBS_ANGLE,     // shooter heading, degrees
+  OBS_SCORE,
+  OBS_LIFE,
+  OBS_FALL,      // distance the bricks fell last tick
+  OBS_BRICKS
+};
+#define BATCH_FEATURES (OBS_BRICKS + 3*BATCH_BRICKS)
+
+typedef struct Batch Batch;
+
+/* games independent games; each one starts over when it ends or after
+ * max_ticks ticks. Game g starts from seed + g and draws the seed of its
+ * next game from its own generator, so a batch plays the same for the
+ * same seed and actions whatever the thread count. Starts the job
+ * threads, 0 for one per core, unless they are already running. */
+Batch* batchCreate (int games, int max_ticks, int threads, uint64_t seed);
+
+void batchDestroy (Batch *batch);
+
+/* Start every game over from the batch's seed and write the first
+ * observations */
+void batchReset (Batch *batch, float *observations);
+
+/* Advance every game one tick. actions[g] is a mask of InputAction bits
+ * (1 << INPUT_FIRE etc.), held for this tick. Writes the new observations,
+ * the score gained in the tick and whether the game ended; a game that
+ * ended has already started over, and its observation is the new game's. */
+void batchStep (Batch *batch, const unsigned *actions, float *observations, float *rewards, unsigned char *dones);
+
+/* Name of the kernel that moves the games' scalars: "avx2", "sse2" or
+ * "scalar" */
+const char* batchKernel (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,61 @@
+#include <cmath>
+#include <algorithm>
+#include "beam.h"
+
+using namespace std;
+
+/* Distance along the ray from (px, py) to the edge of the arena */
+static float arenaExit (float px, float py, float dx, float dy)
+{
+  float tx = dx > 0 ? (BEAM_ARENA - px) / dx : dx < 0 ? (-BEAM_ARENA - px) / dx : 1e30f;
+  float ty = dy > 0 ? (BEAM_ARENA - py) / dy : dy < 0 ? (-BEAM_ARENA - py) / dy : 1e30f;
+  return max(min(tx, ty), 0.0f);
+}
+
+int traceBeam (const MirrorBVH &bvh, const vector<Mirror> &mirrors, float px, float py,
+               float dx, float dy, float dist, float *bx, float *by, float *blen)
+{
+  int count = 0, last = -1;
+  bx[count] = px;
+  by[count] = py;
+  blen[count++] = dist;
+  while(count < BEAM_POINTS)
+  {
+    float exit = arenaExit(px, py, dx, dy), hit;
+    int k = firstMirrorHit(bvh, mirrors, px, py, dx, dy, exit, last, hit);
+    if(k < 0)
+      hit = exit;
+    px += dx*hit;
+    py += dy*hit;
+    dist += hit;
+    bx[count] = px;
+    by[count] = py;
+    blen[count++] = dist;
+    // Out of vertices: the beam ends on this mirror rather than run
+    // through it, and the laser dies there like at the arena edge
+    if(k < 0 || count == BEAM_POINTS)
+      break;
+    reflectOffMirror(mirrors[k], dx, dy);
+    last = k;
+  }
+  return count;
+}
+
+void beamPoint (const float *bx, const float *by, const float *blen, int count, float dist,
+                int &seg, float &x, float &y, float &dx, float &dy)
+{
+  while(seg < count-2 && dist > blen[seg+1])
+    seg++;
+  while(seg > 0 && dist < blen[seg])
+    seg--;
+  float len = blen[seg+1] - blen[seg];
+  dx = bx[seg+1] - bx[seg];
+  dy = by[seg+1] - by[seg];
+  if(len > 0)
+  {
+    dx /= len;
+    dy /= len;
+  }
+  x = bx[seg] + dx*(dist - blen[seg]);
+  y = by[seg] + dy*(dist - blen[seg]);
+}
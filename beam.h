@@ -0,0 +1,31 @@
+#ifndef BEAM_H
+#define BEAM_H
+
+#include <vector>
+#include "mirrors.h"
+
+/* Lasers travel along a polyline traced once, when they are fired, through
+ * the (static) mirrors. Moving a laser is then just advancing its distance
+ * along the polyline; no mirror tests happen while it flies. */
+
+/* Vertices stored per beam; each laser owns a fixed slot of this many */
+#define BEAM_POINTS 16
+
+/* Beams stop being traced once they leave this square around the origin */
+#define BEAM_ARENA 8.0f
+
+/* Trace the beam leaving (px, py) along unit (dx, dy), dist units into its
+ * flight, into bx, by (vertices) and blen (arc length at each vertex).
+ * The last vertex is where it leaves the arena, or, for a beam that meets
+ * more mirrors than it has vertices for (caught between facing mirrors),
+ * the mirror where it runs out; it is absorbed there, never let through.
+ * Returns the vertex count. */
+int traceBeam (const MirrorBVH &bvh, const std::vector<Mirror> &mirrors, float px, float py,
+               float dx, float dy, float dist, float *bx, float *by, float *blen);
+
+/* Point and unit heading at arc length dist. seg is the segment cursor,
+ * kept by the caller so a laser moving forward costs O(1) per step. */
+void beamPoint (const float *bx, const float *by, const float *blen, int count, float dist,
+                int &seg, float &x, float &y, float &dx, float &dy);
+
+#endif
@@ -0,0 +1,110 @@
+/* Benchmark for the audio path headless: replay a recording made with
+ * sample2D --record as fast as it goes, playing the music and the game's
+ * effects to the null backend or, unpaced, to a WAV file, and report how
+ * far ahead of real time the audio threads ran and what mixing the
+ * effects cost.
+ * Build with "make bench_audio" (it needs libmpg123 and libao, which
+ * bench_world doesn't) and run ./bench_audio --replay FILE [options]
+ *   --replay FILE   the recording to replay
+ *   --audio MP3     the music (default spooky1.mp3)
+ *   --wav FILE      write the sound to FILE instead of dropping it */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <chrono>
+
+#include "world.h"
+#include "replay.h"
+#include "audio.h"
+#include "mixer.h"
+
+using namespace std;
+
+static double now_ms ()
+{
+  return chrono::duration<double, milli>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* The effects sample2D plays for a tick's events */
+static void playEffects (const vector<WorldEvent> &events)
+{
+  for(int k=0; k<(int)events.size(); k++)
+  {
+    int type = events[k].type;
+    if(type == EVENT_FIRE)
+      playSfx(SFX_FIRE);
+    else if(type == EVENT_HIT)
+      playSfx(SFX_HIT);
+    else if(type == EVENT_CATCH)
+      playSfx(SFX_CATCH);
+    else if(type == EVENT_LIVES_OVER || type == EVENT_BLACK_BRICK)
+      playSfx(SFX_GAME_OVER);
+  }
+}
+
+/* Let the last effects play out, stop the audio started at start_ms and
+ * say how much sound it made in the time */
+static void reportAudio (double start_ms)
+{
+  drainAudio(1500);
+  stopAudio();
+  double elapsed = now_ms() - start_ms;
+  AudioCounters counters = audioCounters();
+  double seconds = counters.periods * (counters.period_ns / 1e9);
+  const AudioHistograms &histograms = audioHistograms();
+  printf("audio: %lld blocks, %.1f s of sound in %.1f ms, %.0fx real time; %lld effects, %lld cut short, %lld dropped\n",
+         counters.periods, seconds, elapsed, seconds * 1000 / elapsed, counters.sfx_played, counters.sfx_stolen,
+         counters.sfx_dropped);
+  printf("audio: mixing (%s) %.3f us a block on average, %.3f us at the 99th percentile; %lld underruns\n", mixKernel(),
+         counters.mix_ns / 1000.0 / (counters.periods ? counters.periods : 1),
+         histogramPercentile(histograms.mix_ns, 0.99) / 1000.0, counters.underruns);
+}
+
+int main (int argc, char **argv)
+{
+  const char *replay_path = NULL, *audio_path = "spooky1.mp3", *wav_path = NULL;
+  for(int i=1; i<argc; i++)
+  {
+    if(strcmp(argv[i], "--replay") == 0 && i+1 < argc)
+      replay_path = argv[++i];
+    else if(strcmp(argv[i], "--audio") == 0 && i+1 < argc)
+      audio_path = argv[++i];
+    else if(strcmp(argv[i], "--wav") == 0 && i+1 < argc)
+      wav_path = argv[++i];
+  }
+  if(!replay_path)
+  {
+    fprintf(stderr, "usage: bench_audio --replay FILE [--audio MP3] [--wav FILE]\n");
+    return 1;
+  }
+
+  InputReplay replay;
+  if(!loadReplay(replay, replay_path))
+  {
+    fprintf(stderr, "can't read the recording %s\n", replay_path);
+    return 1;
+  }
+  double audio_start = now_ms();
+  if(!startAudio(audio_path, wav_path ? AUDIO_WAV : AUDIO_NULL, wav_path, false))
+  {
+    fprintf(stderr, "can't play %s\n", audio_path);
+    return 1;
+  }
+  World world;
+  resetWorld(world, replay.seed);
+  InputFrame input;
+  int ticks = 0;
+  double start = now_ms();
+  while(!world.over && replayInput(replay, input))
+  {
+    stepWorld(world, input);
+    playEffects(world.events);
+    ticks++;
+  }
+  double elapsed = now_ms() - start;
+  printf("replay: %d ticks in %.1f ms, %.0f ticks/s, score %d, life %d\n",
+         ticks, elapsed, ticks / elapsed * 1000, world.score, world.life);
+  reportAudio(audio_start);
+  return 0;
+}
@@ -0,0 +1,187 @@
+/* Benchmark for the laser vs. brick hit test: brute force against the uniform
+ * grid and sweep and prune; then beam casts against a linear mirror list and
+ * the mirror BVH.
+ * Build with "make bench" and run ./bench_broadphase */
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <chrono>
+
+#include "broadphase.h"
+#include "aabb_simd.h"
+#include "mirrors.h"
+
+using namespace std;
+
+static double now_ms ()
+{
+  return chrono::duration<double, milli>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static float frand (float lo, float hi)
+{
+  return lo + (hi - lo) * (rand() / (float)RAND_MAX);
+}
+
+static bool inside (float px, float py, float bx, float by)
+{
+  return (px >= bx-BRICK_HALF_W && px <= bx+BRICK_HALF_W) && (py >= by-BRICK_HALF_H && py <= by+BRICK_HALF_H);
+}
+
+int main ()
+{
+  const int brick_counts[] = { 1000, 10000, 100000 };
+  const int lazer_counts[] = { 100, 1000, 10000 };
+  BrickGrid grid;
+  const int frames = 10;
+
+  printf("box-vs-brick kernel: %s\n", bricksNearBoxKernel());
+  printf("%8s %8s %12s %12s %12s %12s %12s %8s\n", "bricks", "lasers", "brute ms", "simd ms", "build ms", "query ms", "sap ms", "hits");
+  for(int bi=0; bi<3; bi++)
+  {
+    for(int li=0; li<3; li++)
+    {
+      int n = brick_counts[bi], n1 = lazer_counts[li];
+      // Keep the on-screen brick density: the field grows with the brick count
+      float half = 4 * sqrt(n / 100.0f);
+      vector<float> x(n), y(n), e(n, 1), s_x(n1), s_y(n1), p(n1, 1);
+      srand(n + n1);
+      for(int w=0; w<n; w++)
+      {
+        x[w] = frand(-half, half);
+        y[w] = frand(-half, half);
+      }
+      for(int i=0; i<n1; i++)
+      {
+        s_x[i] = frand(-half, half);
+        s_y[i] = frand(-half, half);
+      }
+
+      long brute_hits = -1, simd_hits = -1;
+      double brute = 0, simd = 0;
+      if((double)n*n1 < 1e9)
+      {
+        double t0 = now_ms();
+        brute_hits = 0;
+        for(int i=0; i<n1; i++)
+          for(int w=0; w<n; w++)
+            if(e[w] == 1 && inside(s_x[i], s_y[i], x[w], y[w]))
+              brute_hits++;
+        brute = now_ms() - t0;
+
+        t0 = now_ms();
+        simd_hits = 0;
+        for(int i=0; i<n1; i++)
+        {
+          int w=0;
+          for(; w+8<=n; w+=8)
+            for(unsigned mask = bricksNearBox8(&x[w], &y[w], &e[w], s_x[i], s_y[i], 0, 0); mask; mask &= mask-1)
+              if(inside(s_x[i], s_y[i], x[w + __builtin_ctz(mask)], y[w + __builtin_ctz(mask)]))
+                simd_hits++;
+          for(; w<n; w++)
+            if(e[w] == 1 && inside(s_x[i], s_y[i], x[w], y[w]))
+              simd_hits++;
+        }
+        simd = now_ms() - t0;
+      }
+
+      double t0 = now_ms();
+      buildBrickGrid(grid, x.data(), y.data(), e.data(), n);
+      double build = now_ms() - t0;
+      long grid_hits = 0;
+      t0 = now_ms();
+      for(int i=0; i<n1; i++)
+      {
+        int count;
+        const int *cell = brickGridCell(grid, s_x[i], s_y[i], count);
+        for(int c=0; c<count; c++)
+          if(e[cell[c]] == 1 && inside(s_x[i], s_y[i], x[cell[c]], y[cell[c]]))
+            grid_hits++;
+      }
+      double query = now_ms() - t0;
+
+      // Sweep and prune from scratch, then per frame with the lasers moving
+      // like they do in the game so the insertion sort sees coherent input
+      SweepAndPrune sap;
+      long sap_hits = 0;
+      updateSweepAndPrune(sap, x.data(), e.data(), n, s_x.data(), s_x.data(), p.data(), n1);
+      for(int k=0; k<(int)sap.pairs.size(); k++)
+      {
+        int i = sap.pairs[k] >> 32, w = sap.pairs[k] & 0xffffffff;
+        if(inside(s_x[i], s_y[i], x[w], y[w]))
+          sap_hits++;
+      }
+      t0 = now_ms();
+      for(int frame=0; frame<frames; frame++)
+      {
+        for(int i=0; i<n1; i++)
+          s_x[i] += 0.1f;
+        updateSweepAndPrune(sap, x.data(), e.data(), n, s_x.data(), s_x.data(), p.data(), n1);
+      }
+      double sweep = (now_ms() - t0) / frames;
+
+      if((brute_hits >= 0 && (brute_hits != grid_hits || simd_hits != grid_hits)) || sap_hits != grid_hits)
+      {
+        cerr << "hit count mismatch: brute " << brute_hits << ", simd " << simd_hits << ", grid " << grid_hits << ", sap " << sap_hits << endl;
+        return 1;
+      }
+      if(brute_hits >= 0)
+        printf("%8d %8d %12.3f %12.3f %12.3f %12.3f %12.3f %8ld\n", n, n1, brute, simd, build, query, sweep, grid_hits);
+      else
+        printf("%8d %8d %12s %12s %12.3f %12.3f %12.3f %8ld\n", n, n1, "-", "-", build, query, sweep, grid_hits);
+    }
+  }
+
+  const int mirror_counts[] = { 4, 100, 1000, 10000 };
+  const int beams = 10000;
+  printf("\n%8s %8s %12s %12s %12s\n", "mirrors", "beams", "linear ms", "bvh ms", "refit ms");
+  for(int mi=0; mi<4; mi++)
+  {
+    int count = mirror_counts[mi];
+    float half = 4 * sqrt(count / 4.0f);
+    vector<Mirror> mirrors;
+    srand(count);
+    for(int k=0; k<count; k++)
+      mirrors.push_back(makeMirror(frand(-half, half), frand(-half, half), 0.4036f, frand(0, 180)));
+    MirrorBVH bvh;
+    buildMirrorBVH(bvh, mirrors);
+    vector<float> px(beams), py(beams), dx(beams), dy(beams);
+    for(int i=0; i<beams; i++)
+    {
+      float a = frand(0, 2*M_PI);
+      px[i] = frand(-half, half);
+      py[i] = frand(-half, half);
+      dx[i] = cos(a);
+      dy[i] = sin(a);
+    }
+
+    long linear_hits = 0, bvh_hits = 0;
+    float dist;
+    double t0 = now_ms();
+    for(int i=0; i<beams; i++)
+      linear_hits += firstMirrorHit(mirrors, px[i], py[i], dx[i], dy[i], 1.0f, -1, dist) >= 0;
+    double linear = now_ms() - t0;
+    t0 = now_ms();
+    for(int i=0; i<beams; i++)
+      bvh_hits += firstMirrorHit(bvh, mirrors, px[i], py[i], dx[i], dy[i], 1.0f, -1, dist) >= 0;
+    double tree = now_ms() - t0;
+    for(int k=0; k<count; k++)
+    {
+      mirrors[k].angle += 5;
+      placeMirror(mirrors[k]);
+    }
+    t0 = now_ms();
+    refitMirrorBVH(bvh, mirrors);
+    double refit = now_ms() - t0;
+
+    if(linear_hits != bvh_hits)
+    {
+      cerr << "mirror hit mismatch: linear " << linear_hits << ", bvh " << bvh_hits << endl;
+      return 1;
+    }
+    printf("%8d %8d %12.3f %12.3f %12.3f\n", count, beams, linear, tree, refit);
+  }
+  return 0;
+}
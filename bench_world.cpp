@@ -0,0 +1,452 @@
+/* Benchmark for the headless World: ticks per second of a normal game with
+ * the fire key held down, then a stress field of many bricks with volleys
+ * of lasers fired into it, then many games stepped together by the batch
+ * API.
+ * Build with "make bench" and run ./bench_world [options]
+ *   --bricks N      bricks in the stress field (default 1000000)
+ *   --threads N     job threads, 0 for one per core (default)
+ *   --collision B   brute, grid or sap
+ *   --games N       games in the batch (default 1024)
+ *   --seed N        seed of the games (default 1)
+ *   --replay FILE   only replay a recording made with sample2D --record,
+ *                   as fast as it goes, and time it (bench_audio does the
+ *                   same with the music and effects playing)
+ *   --loopback      only play both sides of a network game over loopback,
+ *                   one lagging and a third of the packets lost, and check
+ *                   both end where a world fed the same input does
+ *   --catches       only check the catch queue: play random input over
+ *                   waves of bricks and check every tick that it catches
+ *                   exactly the bricks a scan of all of them would
+ *   --roundtrip     only check recordings: record a game of random input,
+ *                   read it back, replay it and check it ends where the
+ *                   game did */
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <chrono>
+
+#include "world.h"
+#include "batch.h"
+#include "replay.h"
+#include "jobs.h"
+#include "netplay.h"
+#include "swept.h"
+
+using namespace std;
+
+/* Ticks timed per run */
+#define GAME_TICKS 100000
+#define STRESS_TICKS 600
+#define BATCH_TICKS 1000
+#define SNAPSHOTS 100000
+#define LOOPBACK_TICKS 20000
+#define LOOPBACK_PORT 47000
+#define CATCH_TICKS 10000
+#define CATCH_WAVE 500    // bricks dropped in at once, every 500 ticks
+#define ROUNDTRIP_TICKS 20000
+#define ROUNDTRIP_PATH "bench_world.bbr"
+
+static double now_ms ()
+{
+  return chrono::duration<double, milli>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Random input that changes every few ticks, as keys are pressed and let go */
+static void randomInput (Rng &rng, vector<InputFrame> &frames, int every)
+{
+  for(int t=0; t<(int)frames.size(); t++)
+  {
+    if(t > 0 && rngBelow(rng, every) != 0)
+    {
+      frames[t] = frames[t-1];
+      continue;
+    }
+    frames[t].held = nextRng(rng) & ((1u << INPUT_ACTIONS) - 1);
+    frames[t].stepped = nextRng(rng) & ((1u << INPUT_ACTIONS) - 1);
+  }
+}
+
+static int loopback (uint64_t seed, int backend)
+{
+  static NetSession sides[2];
+  World worlds[2];
+  worlds[0].collision_backend = worlds[1].collision_backend = backend;
+  if(!netOpen(sides[NET_SHOOTER], worlds[0], NET_SHOOTER, LOOPBACK_PORT, "127.0.0.1", LOOPBACK_PORT+1, seed) ||
+     !netOpen(sides[NET_BASKETS], worlds[1], NET_BASKETS, LOOPBACK_PORT+1, "127.0.0.1", LOOPBACK_PORT, seed+1))
+  {
+    fprintf(stderr, "can't open ports %d and %d\n", LOOPBACK_PORT, LOOPBACK_PORT+1);
+    return 1;
+  }
+  Rng rng;
+  seedRng(rng, seed);
+  vector<InputFrame> input[2];
+  for(int k=0; k<2; k++)
+  {
+    input[k].resize(LOOPBACK_TICKS);
+    randomInput(rng, input[k], 8);
+  }
+
+  // The shooter runs a tick every frame and hears the baskets two frames in
+  // three; the baskets run two ticks every other frame and hear the shooter
+  // every fifth. Each side sends every frame, and a third of that is lost.
+  vector<WorldEvent> events[2];
+  double start = now_ms();
+  for(int frame=1; ; frame++)
+  {
+    NetSession &shooter = sides[NET_SHOOTER], &baskets = sides[NET_BASKETS];
+    if(shooter.tick == LOOPBACK_TICKS && baskets.tick == LOOPBACK_TICKS &&
+       shooter.remote_count >= LOOPBACK_TICKS && baskets.remote_count >= LOOPBACK_TICKS)
+      break;
+    if(frame > 100*LOOPBACK_TICKS)
+    {
+      fprintf(stderr, "loopback: stuck at ticks %d and %d\n", shooter.tick, baskets.tick);
+      return 1;
+    }
+    if(frame%3 != 0)
+      netReceive(shooter);
+    if(frame%5 == 0)
+      netReceive(baskets);
+    if(shooter.tick < LOOPBACK_TICKS && netCanAdvance(shooter))
+      netAdvance(shooter, input[NET_SHOOTER][shooter.tick]);
+    for(int k=0; k<2*(frame%2); k++)
+    {
+      if(baskets.tick < LOOPBACK_TICKS && netCanAdvance(baskets))
+        netAdvance(baskets, input[NET_BASKETS][baskets.tick]);
+    }
+    for(int k=0; k<2; k++)
+    {
+      if(rngBelow(rng, 3) != 0)
+        netSend(sides[k]);
+      netFinalEvents(sides[k], events[k]);
+    }
+  }
+  double elapsed = now_ms() - start;
+
+  // The same game on one machine
+  World alone;
+  alone.collision_backend = backend;
+  resetWorld(alone, seed);
+  vector<WorldEvent> alone_events;
+  unsigned shooter_bits = netRoleActions(NET_SHOOTER), baskets_bits = netRoleActions(NET_BASKETS);
+  for(int t=0; t<LOOPBACK_TICKS; t++)
+  {
+    const InputFrame &shooter = input[NET_SHOOTER][t], &baskets = input[NET_BASKETS][t];
+    InputFrame both = { (shooter.held & shooter_bits) | (baskets.held & baskets_bits),
+                        (shooter.stepped & shooter_bits) | (baskets.stepped & baskets_bits) };
+    stepWorld(alone, both);
+    alone_events.insert(alone_events.end(), alone.events.begin(), alone.events.end());
+  }
+
+  WorldSnapshot expected, got;
+  saveWorld(alone, expected);
+  bool same = true;
+  for(int k=0; k<2; k++)
+  {
+    saveWorld(worlds[k], got);
+    same = same && got.data == expected.data && events[k].size() == alone_events.size();
+    for(int e=0; same && e<(int)alone_events.size(); e++)
+      same = events[k][e].type == alone_events[e].type && events[k][e].score == alone_events[e].score &&
+             events[k][e].life == alone_events[e].life;
+    printf("loopback %s: %d rollbacks, %d ticks run again, %d waits, %d packets sent, %d received\n",
+           k == NET_SHOOTER ? "shooter" : "baskets", sides[k].rollbacks, sides[k].resimulated, sides[k].stalls,
+           sides[k].packets_sent, sides[k].packets_received);
+    netClose(sides[k]);
+  }
+  printf("loopback: %d ticks in %.1f ms, score %d, life %d, %s\n", LOOPBACK_TICKS, elapsed, alone.score, alone.life,
+         same ? "both sides match" : "SIDES DIFFER");
+  return same ? 0 : 1;
+}
+
+/* The catch test of stepWorld() over every brick, as it was before the
+ * queue: which baskets catch brick k, given where it was before the tick
+ * and how far it fell in the last */
+static int scanCatch (const World &world, const vector<float> &y, float fall_step, int k)
+{
+  int baskets = 0;
+  if(sweptThroughBand(y[k]+fall_step, y[k], -2.85, -2.82))
+  {
+    if(world.x[k] >= -2.5+world.q1 && world.x[k] <= -1.5+world.q1)
+      baskets |= 1;
+    if(world.x[k] >= 1.5+world.q2 && world.x[k] <= 2.5+world.q2)
+      baskets |= 2;
+  }
+  return baskets;
+}
+
+static int checkCatches (uint64_t seed, int backend)
+{
+  World world;
+  world.collision_backend = backend;
+  resetWorld(world, seed);
+  Rng rng;
+  seedRng(rng, seed);
+  vector<InputFrame> input(CATCH_TICKS);
+  randomInput(rng, input, 8);
+  // Without lasers a brick only goes when it is caught
+  for(int t=0; t<CATCH_TICKS; t++)
+  {
+    input[t].held &= ~(1u << INPUT_FIRE);
+    input[t].stepped &= ~(1u << INPUT_FIRE);
+  }
+
+  vector<float> y, e;
+  int caught = 0;
+  double start = now_ms();
+  for(int t=0; t<CATCH_TICKS; t++)
+  {
+    if(t%500 == 0)
+    {
+      for(int k=0; k<CATCH_WAVE; k++)
+      {
+        world.x.push_back(rngBelow(rng, 7000)/1000.0f - 3);
+        world.y.push_back(rngBelow(rng, 7000)/1000.0f - 2.8);
+        world.z.push_back(rngBelow(rng, 3));
+        world.e.push_back(1);
+        scheduleCatch(world.catch_queue, world.n, world.fallen + (world.y[world.n] - -2.82));
+        world.n++;
+      }
+    }
+    y = world.y;
+    e = world.e;
+    float fall_step = world.fall_step;
+    stepWorld(world, input[t]);
+
+    int events = 0, scanned = 0;
+    for(int k=0; k<(int)world.events.size(); k++)
+      events += world.events[k].type == EVENT_CATCH;
+    for(int k=0; k<(int)e.size(); k++)
+    {
+      if(e[k] != 1)
+        continue;
+      int baskets = scanCatch(world, y, fall_step, k);
+      scanned += (baskets & 1) + (baskets >> 1);
+      if((baskets != 0) != (world.e[k] == 0))
+      {
+        fprintf(stderr, "catches: tick %d, brick %d at %.4f fell %.4f: the scan says %s, the queue %s\n", t, k, y[k],
+                fall_step, baskets ? "caught" : "not caught", world.e[k] == 0 ? "caught" : "not caught");
+        return 1;
+      }
+    }
+    if(events != scanned)
+    {
+      fprintf(stderr, "catches: tick %d: %d catches reported, the scan makes it %d\n", t, events, scanned);
+      return 1;
+    }
+    caught += events;
+  }
+  printf("catches: %d ticks, %d bricks, %d caught in %.1f ms, all as a scan of every brick has them\n",
+         CATCH_TICKS, world.n, caught, now_ms() - start);
+  return 0;
+}
+
+static int roundtrip (uint64_t seed, int backend)
+{
+  Rng rng;
+  seedRng(rng, seed);
+  vector<InputFrame> input(ROUNDTRIP_TICKS);
+  // Runs a few ticks long, and runs long enough for their length to take
+  // more than one byte
+  randomInput(rng, input, 8);
+  for(int t=ROUNDTRIP_TICKS/2; t<ROUNDTRIP_TICKS; t++)
+  {
+    if(t%1000 != 0)
+      input[t] = input[t-1];
+  }
+
+  World world;
+  world.collision_backend = backend;
+  resetWorld(world, seed);
+  InputRecorder recorder;
+  if(!startRecording(recorder, ROUNDTRIP_PATH, seed))
+  {
+    fprintf(stderr, "can't create %s\n", ROUNDTRIP_PATH);
+    return 1;
+  }
+  for(int t=0; t<ROUNDTRIP_TICKS; t++)
+  {
+    recordInput(recorder, input[t]);
+    stepWorld(world, input[t]);
+  }
+  stopRecording(recorder);
+
+  InputReplay replay;
+  bool loaded = loadReplay(replay, ROUNDTRIP_PATH);
+  size_t bytes = replay.data.size();
+  remove(ROUNDTRIP_PATH);
+  if(!loaded)
+  {
+    fprintf(stderr, "can't read back %s\n", ROUNDTRIP_PATH);
+    return 1;
+  }
+  World again;
+  again.collision_backend = backend;
+  resetWorld(again, replay.seed);
+  InputFrame frame;
+  int ticks = 0;
+  bool same = replay.seed == seed;
+  while(same && replayInput(replay, frame))
+  {
+    same = ticks < ROUNDTRIP_TICKS && frame.held == input[ticks].held && frame.stepped == input[ticks].stepped;
+    stepWorld(again, frame);
+    ticks++;
+  }
+  WorldSnapshot expected, got;
+  saveWorld(world, expected);
+  saveWorld(again, got);
+  same = same && ticks == ROUNDTRIP_TICKS && got.data == expected.data;
+  printf("roundtrip: %d ticks in %d bytes, %d replayed, score %d, life %d, %s\n", ROUNDTRIP_TICKS, (int)bytes,
+         ticks, world.score, world.life, same ? "the replay matches" : "THE REPLAY DIFFERS");
+  return same ? 0 : 1;
+}
+
+int main (int argc, char **argv)
+{
+  int bricks = 1000000, threads = 0, backend = COLLIDE_GRID, games = 1024;
+  uint64_t seed = 1;
+  const char *replay_path = NULL;
+  bool net_loopback = false, catches = false, check_roundtrip = false;
+  for(int i=1; i<argc; i++)
+  {
+    if(strcmp(argv[i], "--bricks") == 0 && i+1 < argc)
+      bricks = atoi(argv[++i]);
+    else if(strcmp(argv[i], "--threads") == 0 && i+1 < argc)
+      threads = atoi(argv[++i]);
+    else if(strcmp(argv[i], "--seed") == 0 && i+1 < argc)
+      seed = strtoull(argv[++i], NULL, 10);
+    else if(strcmp(argv[i], "--replay") == 0 && i+1 < argc)
+      replay_path = argv[++i];
+    else if(strcmp(argv[i], "--loopback") == 0)
+      net_loopback = true;
+    else if(strcmp(argv[i], "--catches") == 0)
+      catches = true;
+    else if(strcmp(argv[i], "--roundtrip") == 0)
+      check_roundtrip = true;
+    else if(strcmp(argv[i], "--games") == 0 && i+1 < argc)
+      games = atoi(argv[++i]);
+    else if(strcmp(argv[i], "--collision") == 0 && i+1 < argc)
+    {
+      backend = parseCollisionBackend(argv[++i]);
+      if(backend < 0)
+      {
+        fprintf(stderr, "--collision takes brute, grid or sap\n");
+        return 1;
+      }
+    }
+  }
+  startJobs(threads);
+  if(net_loopback)
+    return loopback(seed, backend);
+  if(catches)
+    return checkCatches(seed, backend);
+  if(check_roundtrip)
+    return roundtrip(seed, backend);
+
+  if(replay_path)
+  {
+    InputReplay replay;
+    if(!loadReplay(replay, replay_path))
+    {
+      fprintf(stderr, "can't read the recording %s\n", replay_path);
+      return 1;
+    }
+    World world;
+    world.collision_backend = backend;
+    resetWorld(world, replay.seed);
+    InputFrame input;
+    int ticks = 0;
+    double start = now_ms();
+    while(!world.over && replayInput(replay, input))
+    {
+      stepWorld(world, input);
+      ticks++;
+    }
+    double elapsed = now_ms() - start;
+    printf("replay: %d ticks in %.1f ms, %.0f ticks/s, score %d, life %d\n",
+           ticks, elapsed, ticks / elapsed * 1000, world.score, world.life);
+    return 0;
+  }
+
+  // A game as it is played: a brick every 1.5 s, a shot every second
+  World world;
+  world.collision_backend = backend;
+  resetWorld(world, seed);
+  InputFrame fire = { 1u << INPUT_FIRE, 0 };
+  double start = now_ms();
+  for(int t=0; t<GAME_TICKS; t++)
+  {
+    stepWorld(world, fire);
+    if(world.over)
+    {
+      resetWorld(world, nextRng(world.rng));
+    }
+  }
+  double elapsed = now_ms() - start;
+  printf("game: %d ticks in %.1f ms, %.0f ticks/s\n", GAME_TICKS, elapsed, GAME_TICKS / elapsed * 1000);
+
+  // Snapshots of the game as it stands, as rewind or rollback would take them
+  WorldSnapshot snapshot;
+  saveWorld(world, snapshot);
+  start = now_ms();
+  for(int k=0; k<SNAPSHOTS; k++)
+    saveWorld(world, snapshot);
+  double saved = now_ms() - start;
+  start = now_ms();
+  for(int k=0; k<SNAPSHOTS; k++)
+    restoreWorld(world, snapshot);
+  double restored = now_ms() - start;
+  printf("snapshot: %d bricks, %d lasers, %d bytes: save %.0f ns, restore %.0f ns\n", world.n, world.n1,
+         (int)snapshot.data.size(), saved / SNAPSHOTS * 1e6, restored / SNAPSHOTS * 1e6);
+
+  // The stress field: far more bricks than a game ever reaches
+  resetWorld(world, seed);
+  InputFrame idle = { 0, 0 };
+  Rng field;
+  seedRng(field, seed);
+  for(int k=0; k<bricks; k++)
+  {
+    world.x.push_back(rngBelow(field, 7000)/1000.0f - 3);
+    world.y.push_back(rngBelow(field, 7000)/1000.0f - 2.8);
+    world.z.push_back(rngBelow(field, 3));
+    world.e.push_back(1);
+    scheduleCatch(world.catch_queue, world.n, world.fallen + (world.y[world.n] - -2.82));
+    world.n++;
+  }
+  int volley = bricks/1000 + 1;
+  start = now_ms();
+  for(int t=0; t<STRESS_TICKS; t++)
+  {
+    if(t%60 == 0)
+    {
+      for(int k=0; k<volley; k++)
+        fireLazer(world, -3.5 + 7.0*k/volley, -80 + 160.0*k/volley);
+    }
+    stepWorld(world, idle);
+  }
+  elapsed = now_ms() - start;
+  printf("stress: %d bricks, %d lasers, %d threads: %.3f ms/tick, score %d, life %d\n",
+         bricks, world.n1, jobThreads(), elapsed / STRESS_TICKS, world.score, world.life);
+
+  // Rollouts: every game fires and moves at random, ten minutes per game at most
+  Batch *batch = batchCreate(games, 36000, threads, seed);
+  vector<float> observations(games*BATCH_FEATURES), rewards(games);
+  vector<unsigned char> dones(games);
+  vector<unsigned> actions(games);
+  batchReset(batch, observations.data());
+  int ended = 0;
+  start = now_ms();
+  for(int t=0; t<BATCH_TICKS; t++)
+  {
+    for(int g=0; g<games; g++)
+      actions[g] = nextRng(field) & ((1u << INPUT_ACTIONS) - 1);
+    batchStep(batch, actions.data(), observations.data(), rewards.data(), dones.data());
+    for(int g=0; g<games; g++)
+      ended += dones[g];
+  }
+  elapsed = now_ms() - start;
+  printf("batch (%s): %d games, %d ticks in %.1f ms, %.0f game ticks/s, %d games ended\n",
+         batchKernel(), games, BATCH_TICKS, elapsed, (double)games*BATCH_TICKS / elapsed * 1000, ended);
+  batchDestroy(batch);
+  return 0;
+}
@@ -0,0 +1,188 @@
+#include <cmath>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "broadcast.h"
+
+using namespace std;
+
+static const uint32_t FEED_MAGIC = 0x44454642;  // "BFED"
+
+static Feed *mapFeed (const char *name, bool write)
+{
+  int fd = shm_open(name, write ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+  if(fd < 0)
+    return NULL;
+  if(write && ftruncate(fd, sizeof(Feed)) < 0)
+  {
+    close(fd);
+    return NULL;
+  }
+  struct stat info;
+  if(fstat(fd, &info) < 0 || info.st_size < (off_t)sizeof(Feed))
+  {
+    close(fd);
+    return NULL;
+  }
+  void *memory = mmap(NULL, sizeof(Feed), write ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  return memory == MAP_FAILED ? NULL : (Feed*)memory;
+}
+
+Feed *createFeed (const char *name)
+{
+  Feed *feed = mapFeed(name, true);
+  if(!feed)
+    return NULL;
+  // A fresh mapping is zeros, which is no frames and even sequences; the
+  // magic goes last so a viewer never takes a half made feed
+  feed->size = sizeof(Feed);
+  feed->frames.store(0, memory_order_relaxed);
+  for(int k=0; k<FEED_SLOTS; k++)
+    feed->slots[k].seq.store(0, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  feed->magic = FEED_MAGIC;
+  return feed;
+}
+
+const Feed *openFeed (const char *name)
+{
+  Feed *feed = mapFeed(name, false);
+  if(feed && (feed->magic != FEED_MAGIC || feed->size != sizeof(Feed)))
+  {
+    munmap(feed, sizeof(Feed));
+    return NULL;
+  }
+  return feed;
+}
+
+void closeFeed (const Feed *feed)
+{
+  if(feed)
+    munmap((void*)feed, sizeof(Feed));
+}
+
+void removeFeed (const char *name)
+{
+  shm_unlink(name);
+}
+
+void publishFrame (Feed *feed, const World &world, int tick, float alpha)
+{
+  uint32_t frames = feed->frames.load(memory_order_relaxed);
+  FeedSlot &slot = feed->slots[frames % FEED_SLOTS];
+  uint32_t seq = slot.seq.load(memory_order_relaxed);
+  slot.seq.store(seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+
+  FeedFrame &out = slot.frame;
+  out.frame = frames;
+  out.tick = tick;
+  out.score = world.score;
+  out.life = world.life;
+  out.over = world.over;
+  out.q1 = world.q1;
+  out.q2 = world.q2;
+  out.q3 = world.q3;
+  out.angle = world.angle;
+  for(int k=0; k<4; k++)
+    out.mirror_angle[k] = k < (int)world.mirrors.size() ? world.mirrors[k].angle : 0;
+
+  // The same positions draw() uses for this alpha
+  float fall = world.fall_step*(1-alpha);
+  int bricks = 0;
+  for(int i=0; i<world.n && bricks<FEED_BRICKS; i++)
+  {
+    if(world.e[i] != 1)
+      continue;
+    out.brick_x[bricks] = world.x[i];
+    out.brick_y[bricks] = world.y[i] + fall;
+    out.brick_colour[bricks] = (unsigned char)world.z[i];
+    bricks++;
+  }
+  out.bricks = bricks;
+  int lazers = 0;
+  for(int i=0; i<world.n1 && lazers<FEED_LAZERS; i++)
+  {
+    if(world.p[i] != 1)
+      continue;
+    float px, py, dx, dy;
+    int seg = world.beam_seg[i];
+    lazerPoint(world, i, max(world.r[i] - LAZER_STEP*(1-alpha), 0.0f), seg, px, py, dx, dy);
+    out.lazer_x[lazers] = px;
+    out.lazer_y[lazers] = py;
+    out.lazer_heading[lazers] = atan2(dy, dx);
+    lazers++;
+  }
+  out.lazers = lazers;
+
+  slot.seq.store(seq + 2, memory_order_release);
+  feed->frames.store(frames + 1, memory_order_release);
+}
+
+bool readFrame (const Feed *feed, uint32_t &seen, FeedFrame &frame, int &retries)
+{
+  for(int attempt=0; attempt<FEED_SLOTS; attempt++)
+  {
+    uint32_t frames = feed->frames.load(memory_order_acquire);
+    if(frames == seen)
+      return false;
+    const FeedSlot &slot = feed->slots[(frames - 1) % FEED_SLOTS];
+    uint32_t seq = slot.seq.load(memory_order_acquire);
+    if(!(seq & 1))
+    {
+      // Only as much as the frame holds; a torn count is caught below
+      const FeedFrame &in = slot.frame;
+      memcpy(&frame, &in, offsetof(FeedFrame, brick_x));
+      int bricks = min(max(frame.bricks, 0), FEED_BRICKS), lazers = min(max(frame.lazers, 0), FEED_LAZERS);
+      memcpy(frame.brick_x, in.brick_x, bricks*sizeof(float));
+      memcpy(frame.brick_y, in.brick_y, bricks*sizeof(float));
+      memcpy(frame.brick_colour, in.brick_colour, bricks);
+      memcpy(frame.lazer_x, in.lazer_x, lazers*sizeof(float));
+      memcpy(frame.lazer_y, in.lazer_y, lazers*sizeof(float));
+      memcpy(frame.lazer_heading, in.lazer_heading, lazers*sizeof(float));
+      atomic_thread_fence(memory_order_acquire);
+      if(slot.seq.load(memory_order_relaxed) == seq)
+      {
+        seen = frames;
+        return true;
+      }
+    }
+    retries++;
+  }
+  return false;
+}
+
+void showFrame (const FeedFrame &frame, World &world)
+{
+  world.score = frame.score;
+  world.life = frame.life;
+  world.over = frame.over;
+  world.q1 = frame.q1;
+  world.q2 = frame.q2;
+  world.q3 = frame.q3;
+  world.angle = frame.angle;
+  for(int k=0; k<4 && k<(int)world.mirrors.size(); k++)
+  {
+    world.mirrors[k].angle = frame.mirror_angle[k];
+    placeMirror(world.mirrors[k]);
+  }
+  world.fall_step = 0;
+
+  int n = frame.bricks;
+  world.n = n;
+  world.x.assign(frame.brick_x, frame.brick_x + n);
+  world.y.assign(frame.brick_y, frame.brick_y + n);
+  world.z.resize(n);
+  world.e.assign(n, 1);
+  for(int i=0; i<n; i++)
+    world.z[i] = frame.brick_colour[i];
+
+  showLazers(world, frame.lazers);
+  for(int i=0; i<frame.lazers; i++)
+    placeLazer(world, i, frame.lazer_x[i], frame.lazer_y[i], frame.lazer_heading[i], true);
+}
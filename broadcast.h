@@ -0,0 +1,65 @@
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include <atomic>
+#include <stdint.h>
+#include "world.h"
+
+/* The game as drawn, published every frame into POSIX shared memory for
+ * any number of viewer processes on the same machine. The feed is a ring
+ * of frames, each guarded by a seqlock: the game never waits for a viewer,
+ * and a viewer that catches a frame being written just reads it again.
+ * Viewers map the feed read only, so they can't disturb the game or each
+ * other, and cost it nothing. */
+
+#define FEED_SLOTS 4
+#define FEED_BRICKS 4096    // live bricks and lasers a frame holds at most
+#define FEED_LAZERS 1024
+
+/* One frame, positions already interpolated to where they are drawn */
+struct FeedFrame {
+  uint32_t frame;           // frames published before this one
+  int tick, score, life, over;
+  float q1, q2, q3, angle;
+  float mirror_angle[4];
+  int bricks, lazers;       // live ones, in the arrays below
+  float brick_x[FEED_BRICKS], brick_y[FEED_BRICKS];
+  unsigned char brick_colour[FEED_BRICKS];
+  float lazer_x[FEED_LAZERS], lazer_y[FEED_LAZERS], lazer_heading[FEED_LAZERS];
+};
+
+struct FeedSlot {
+  std::atomic<uint32_t> seq;  // odd while the frame is being written
+  FeedFrame frame;
+};
+
+struct Feed {
+  uint32_t magic, size;
+  std::atomic<uint32_t> frames;  // published so far; the newest is in slot (frames-1) % FEED_SLOTS
+  FeedSlot slots[FEED_SLOTS];
+};
+
+/* Create the feed /name for writing, replacing one left behind; NULL if
+ * shared memory can't be had */
+Feed *createFeed (const char *name);
+
+/* Map the feed /name read only; NULL if there is none */
+const Feed *openFeed (const char *name);
+
+void closeFeed (const Feed *feed);
+
+/* Remove /name; viewers keep what they mapped until they close it */
+void removeFeed (const char *name);
+
+/* Publish world as drawn alpha of the way into the coming tick */
+void publishFrame (Feed *feed, const World &world, int tick, float alpha);
+
+/* Copy the newest frame if it is newer than seen, which it updates.
+ * False if there is nothing new or the writer kept overtaking the copy;
+ * retries counts the copies that had to start over. */
+bool readFrame (const Feed *feed, uint32_t &seen, FeedFrame &frame, int &retries);
+
+/* Set up world to be drawn as the frame; nothing in it is simulated */
+void showFrame (const FeedFrame &frame, World &world);
+
+#endif
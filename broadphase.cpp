@@ -0,0 +1,201 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "broadphase.h"
+
+using namespace std;
+
+/* Grow the AABBs a little so points on a brick edge always land in one of its cells */
+#define GRID_PAD 1e-4f
+
+void buildBrickGrid (BrickGrid &grid, const float *x, const float *y, const float *e, int n)
+{
+  float max_x = 0, max_y = 0;
+  int live = 0;
+
+  grid.min_x = grid.min_y = 0;
+  for(int w=0; w<n; w++)
+  {
+    if(e[w] != 1)
+      continue;
+    if(live == 0 || x[w] < grid.min_x) grid.min_x = x[w];
+    if(live == 0 || y[w] < grid.min_y) grid.min_y = y[w];
+    if(live == 0 || x[w] > max_x) max_x = x[w];
+    if(live == 0 || y[w] > max_y) max_y = y[w];
+    live++;
+  }
+  grid.min_x -= BRICK_HALF_W + GRID_PAD;
+  grid.min_y -= BRICK_HALF_H + GRID_PAD;
+  max_x += BRICK_HALF_W + GRID_PAD;
+  max_y += BRICK_HALF_H + GRID_PAD;
+
+  // One brick per cell, unless the bricks are so spread out that the grid
+  // would have far more cells than bricks; then coarsen it
+  grid.cell_w = 2*BRICK_HALF_W;
+  grid.cell_h = 2*BRICK_HALF_H;
+  float span_x = (max_x - grid.min_x) / grid.cell_w + 1;
+  float span_y = (max_y - grid.min_y) / grid.cell_h + 1;
+  float limit = 4.0f*live + 64;
+  if(span_x*span_y > limit)
+  {
+    float scale = sqrt(span_x*span_y / limit);
+    grid.cell_w *= scale;
+    grid.cell_h *= scale;
+  }
+  grid.cols = live ? (int)((max_x - grid.min_x) / grid.cell_w) + 1 : 0;
+  grid.rows = live ? (int)((max_y - grid.min_y) / grid.cell_h) + 1 : 0;
+
+  int cells = grid.cols * grid.rows;
+  grid.cell_start.assign(cells + 1, 0);
+  grid.brick_cells.resize(4*n);
+
+  // Count the bricks overlapping each cell
+  int total = 0;
+  for(int w=0; w<n; w++)
+  {
+    int *range = &grid.brick_cells[4*w];
+    if(e[w] != 1)
+    {
+      range[0] = 1;
+      range[2] = 0;
+      continue;
+    }
+    range[0] = (int)((x[w] - BRICK_HALF_W - GRID_PAD - grid.min_x) / grid.cell_w);
+    range[1] = (int)((y[w] - BRICK_HALF_H - GRID_PAD - grid.min_y) / grid.cell_h);
+    range[2] = (int)((x[w] + BRICK_HALF_W + GRID_PAD - grid.min_x) / grid.cell_w);
+    range[3] = (int)((y[w] + BRICK_HALF_H + GRID_PAD - grid.min_y) / grid.cell_h);
+    if(range[0] < 0) range[0] = 0;
+    if(range[1] < 0) range[1] = 0;
+    if(range[2] >= grid.cols) range[2] = grid.cols - 1;
+    if(range[3] >= grid.rows) range[3] = grid.rows - 1;
+    for(int cy=range[1]; cy<=range[3]; cy++)
+      for(int cx=range[0]; cx<=range[2]; cx++)
+        grid.cell_start[cy*grid.cols + cx + 1]++;
+    total += (range[2] - range[0] + 1) * (range[3] - range[1] + 1);
+  }
+
+  // Prefix sum, then scatter the brick indices in ascending order
+  for(int c=0; c<cells; c++)
+    grid.cell_start[c+1] += grid.cell_start[c];
+  grid.cell_items.resize(total);
+  for(int w=0; w<n; w++)
+  {
+    const int *range = &grid.brick_cells[4*w];
+    if(range[0] > range[2])
+      continue;
+    for(int cy=range[1]; cy<=range[3]; cy++)
+      for(int cx=range[0]; cx<=range[2]; cx++)
+        grid.cell_items[grid.cell_start[cy*grid.cols + cx]++] = w;
+  }
+  // The scatter advanced every start to the next cell's start; shift back
+  for(int c=cells; c>0; c--)
+    grid.cell_start[c] = grid.cell_start[c-1];
+  grid.cell_start[0] = 0;
+}
+
+const int* brickGridCell (const BrickGrid &grid, float px, float py, int &count)
+{
+  count = 0;
+  if(grid.cols == 0 || px < grid.min_x || py < grid.min_y)
+    return 0;
+  int cx = (int)((px - grid.min_x) / grid.cell_w);
+  int cy = (int)((py - grid.min_y) / grid.cell_h);
+  if(cx >= grid.cols || cy >= grid.rows)
+    return 0;
+  int c = cy*grid.cols + cx;
+  count = grid.cell_start[c+1] - grid.cell_start[c];
+  return &grid.cell_items[0] + grid.cell_start[c];
+}
+
+void brickGridQuery (const BrickGrid &grid, float lo_x, float lo_y, float hi_x, float hi_y, vector<int> &out)
+{
+  out.clear();
+  if(grid.cols == 0)
+    return;
+  int cx0 = (int)floor((lo_x - grid.min_x) / grid.cell_w);
+  int cy0 = (int)floor((lo_y - grid.min_y) / grid.cell_h);
+  int cx1 = (int)floor((hi_x - grid.min_x) / grid.cell_w);
+  int cy1 = (int)floor((hi_y - grid.min_y) / grid.cell_h);
+  if(cx0 < 0) cx0 = 0;
+  if(cy0 < 0) cy0 = 0;
+  if(cx1 >= grid.cols) cx1 = grid.cols - 1;
+  if(cy1 >= grid.rows) cy1 = grid.rows - 1;
+  for(int cy=cy0; cy<=cy1; cy++)
+  {
+    for(int cx=cx0; cx<=cx1; cx++)
+    {
+      int c = cy*grid.cols + cx;
+      out.insert(out.end(), grid.cell_items.begin() + grid.cell_start[c], grid.cell_items.begin() + grid.cell_start[c+1]);
+    }
+  }
+  // A brick spanning several cells shows up once per cell
+  if(cx0 != cx1 || cy0 != cy1)
+  {
+    sort(out.begin(), out.end());
+    out.erase(unique(out.begin(), out.end()), out.end());
+  }
+}
+
+void updateSweepAndPrune (SweepAndPrune &sap, const float *x, const float *e, int n,
+                          const float *lo, const float *hi, const float *p, int n1)
+{
+  // Drop dead bricks, then insert the ones spawned since the last update
+  int live = 0;
+  for(int k=0; k<(int)sap.bricks.size(); k++)
+    if(e[sap.bricks[k]] == 1)
+      sap.bricks[live++] = sap.bricks[k];
+  sap.bricks.resize(live);
+  for(int w=sap.known_bricks; w<n; w++)
+  {
+    if(e[w] != 1)
+      continue;
+    sap.bricks.push_back(w);
+    for(int k=sap.bricks.size()-1; k>0 && x[sap.bricks[k-1]] > x[w]; k--)
+      swap(sap.bricks[k], sap.bricks[k-1]);
+  }
+  sap.known_bricks = n;
+
+  // Same for the lasers, which are re-sorted by their new lo every frame
+  live = 0;
+  for(int k=0; k<(int)sap.lazers.size(); k++)
+    if(p[sap.lazers[k]] == 1)
+      sap.lazers[live++] = sap.lazers[k];
+  sap.lazers.resize(live);
+  for(int i=sap.known_lazers; i<n1; i++)
+    if(p[i] == 1)
+      sap.lazers.push_back(i);
+  sap.known_lazers = n1;
+  for(int k=1; k<(int)sap.lazers.size(); k++)
+  {
+    int i = sap.lazers[k];
+    int j = k;
+    for(; j>0 && lo[sap.lazers[j-1]] > lo[i]; j--)
+      sap.lazers[j] = sap.lazers[j-1];
+    sap.lazers[j] = i;
+  }
+
+  // Sweep: a brick overlaps [lo, hi] iff its centre is in [lo - w, hi + w].
+  // The first candidate only moves right as lo increases.
+  sap.pairs.clear();
+  int first = 0, nb = sap.bricks.size();
+  for(int k=0; k<(int)sap.lazers.size(); k++)
+  {
+    int i = sap.lazers[k];
+    while(first < nb && x[sap.bricks[first]] < lo[i] - BRICK_HALF_W)
+      first++;
+    for(int b=first; b<nb && x[sap.bricks[b]] <= hi[i] + BRICK_HALF_W; b++)
+      sap.pairs.push_back(((long long)i << 32) | sap.bricks[b]);
+  }
+  sort(sap.pairs.begin(), sap.pairs.end());
+}
+
+int parseCollisionBackend (const char *name)
+{
+  if(strcmp(name, "brute") == 0)
+    return COLLIDE_BRUTE;
+  if(strcmp(name, "grid") == 0)
+    return COLLIDE_GRID;
+  if(strcmp(name, "sap") == 0)
+    return COLLIDE_SAP;
+  return -1;
+}
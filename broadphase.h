@@ -0,0 +1,63 @@
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include <vector>
+
+/* Half extents of a brick, matching the vertices in createRedBrick() etc. */
+#define BRICK_HALF_W 0.125f
+#define BRICK_HALF_H 0.15f
+
+/* Uniform grid over the AABBs of the live bricks.
+ * Cells are one brick in size, so a brick overlaps at most 4 cells and a
+ * laser tip only has to look at the bricks of the single cell it is in.
+ * Storage is a counting-sort (CSR) layout that is rebuilt every frame and
+ * reuses its buffers, so steady state does no allocation. */
+struct BrickGrid {
+  float min_x, min_y;
+  float cell_w, cell_h;
+  int cols, rows;
+  std::vector<int> cell_start;  // cols*rows+1 offsets into cell_items
+  std::vector<int> cell_items;  // brick indices, ascending within a cell
+  std::vector<int> brick_cells; // scratch: per brick first/last column and row
+};
+
+/* Rebuild the grid from the brick columns (x, y centre, e alive flag) */
+void buildBrickGrid (BrickGrid &grid, const float *x, const float *y, const float *e, int n);
+
+/* Candidate bricks for a point, in ascending index order */
+const int* brickGridCell (const BrickGrid &grid, float px, float py, int &count);
+
+/* Candidate bricks for a box (e.g. a laser's sweep this frame), written to
+ * out in ascending index order without duplicates */
+void brickGridQuery (const BrickGrid &grid, float lo_x, float lo_y, float hi_x, float hi_y, std::vector<int> &out);
+
+/* Sweep and prune along x.
+ * Bricks never move sideways, so their order is fixed once inserted; lasers
+ * move a little every frame, so an insertion sort of last frame's order is
+ * close to O(n). Candidate pairs are sorted by (laser, brick) so hits are
+ * resolved in the same order as the brute force loop. */
+struct SweepAndPrune {
+  int known_bricks;             // bricks [0, known_bricks) have been inserted
+  int known_lazers;             // likewise for lasers
+  std::vector<int> bricks;      // live brick indices sorted by x
+  std::vector<int> lazers;      // laser indices sorted by lo
+  std::vector<long long> pairs; // candidates, (laser << 32) | brick
+  SweepAndPrune () : known_bricks(0), known_lazers(0) {}
+};
+
+/* Update the sorted lists and collect the candidate pairs. Laser i spans
+ * [lo[i], hi[i]] along x and takes part only while p[i] == 1. */
+void updateSweepAndPrune (SweepAndPrune &sap, const float *x, const float *e, int n,
+                          const float *lo, const float *hi, const float *p, int n1);
+
+/* Collision backends selectable with --collision */
+enum CollisionBackend {
+  COLLIDE_BRUTE,
+  COLLIDE_GRID,
+  COLLIDE_SAP
+};
+
+/* Parse "brute", "grid" or "sap"; returns -1 for anything else */
+int parseCollisionBackend (const char *name);
+
+#endif
@@ -0,0 +1,30 @@
+#include <algorithm>
+#include "catchqueue.h"
+
+using namespace std;
+
+/* Heap order: the earliest event on top, ties by brick index */
+static bool later (const CatchEvent &a, const CatchEvent &b)
+{
+  return a.at > b.at || (a.at == b.at && a.brick > b.brick);
+}
+
+void scheduleCatch (CatchQueue &queue, int brick, double at)
+{
+  CatchEvent event;
+  event.at = at;
+  event.brick = brick;
+  event.spare = 0;
+  queue.heap.push_back(event);
+  push_heap(queue.heap.begin(), queue.heap.end(), later);
+}
+
+void dueCatches (CatchQueue &queue, double fallen)
+{
+  while(!queue.heap.empty() && queue.heap.front().at <= fallen)
+  {
+    queue.in_band.push_back(queue.heap.front().brick);
+    pop_heap(queue.heap.begin(), queue.heap.end(), later);
+    queue.heap.pop_back();
+  }
+}
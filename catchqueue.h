@@ -0,0 +1,31 @@
+#ifndef CATCHQUEUE_H
+#define CATCHQUEUE_H
+
+#include <vector>
+
+/* Event queue for basket catches.
+ * Every brick falls by the same amount each tick, so instead of time the
+ * queue is keyed by the total distance fallen: a brick spawned when the
+ * bricks had fallen F, at height h above the catch band, reaches the band
+ * when they have fallen F + h. That key does not depend on the fall speed,
+ * so changing it with N or M invalidates nothing, and the baskets are
+ * looked at only when a brick is due, so moving them invalidates nothing
+ * either. Catch resolution costs O(log n) per brick instead of O(n) per tick. */
+struct CatchEvent {
+  double at;   // total fall at which the brick reaches the band
+  int brick;
+  int spare;   // always 0: fills the padding, so equal queues snapshot to equal bytes
+};
+
+struct CatchQueue {
+  std::vector<CatchEvent> heap;  // min-heap on (at, brick)
+  std::vector<int> in_band;      // due bricks, tested every tick until they leave the band
+};
+
+/* Brick will reach the band once the bricks have fallen at */
+void scheduleCatch (CatchQueue &queue, int brick, double at);
+
+/* Move every brick due by the time the bricks have fallen `fallen` to in_band */
+void dueCatches (CatchQueue &queue, double fallen);
+
+#endif
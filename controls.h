@@ -0,0 +1,53 @@
+#ifndef CONTROLS_H
+#define CONTROLS_H
+
+#include <cmath>
+#include "input.h"
+
+/* The per-tick updates of a game's scalars (baskets, shooter, counters,
+ * fall speed), written as selects on values rather than branches on a
+ * World, so stepWorld() runs them on one game and batch.cpp down columns
+ * of many games with the compiler's SIMD, both rounding alike. */
+
+#define SPAWN_TICKS 90   // a brick every 1.5 s
+#define FIRE_TICKS 60    // a shot every second at most
+
+inline bool actionBit (unsigned actions, int action)
+{
+  return (actions >> action) & 1;
+}
+
+/* A control moved a step up and then down for the keys that step it; the
+ * sums are in double, as the game always did them. Both sides of each
+ * select are worked out, so a loop of these has no branches. */
+inline float stepControl (float value, bool up, bool down, double step)
+{
+  float raised = value + step;
+  value = up ? raised : value;
+  float lowered = value - step;
+  return down ? lowered : value;
+}
+
+/* Pushed back a step once value + offset reaches hi, then lo */
+inline float clampControl (float value, float offset, float hi, float lo, double step)
+{
+  float lowered = value - step;
+  value = value + offset >= hi ? lowered : value;
+  float raised = value + step;
+  return value + offset <= lo ? raised : value;
+}
+
+/* How far the bricks fall in a tick with these actions held */
+inline float fallStep (unsigned held)
+{
+  return actionBit(held, INPUT_FALL_FAST) ? 0.1f : actionBit(held, INPUT_FALL_SLOW) ? 0.002f : 0.007f;
+}
+
+/* Where a shot leaves the shooter at height q3, heading angle degrees */
+inline float fireHeight (float q3, float angle)
+{
+  float rise = sin(angle * M_PI/180.0f) * 0.45;
+  return q3 + rise;
+}
+
+#endif
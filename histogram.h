@@ -0,0 +1,74 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <atomic>
+#include <stdint.h>
+
+/* Counts of non-negative values in log-linear buckets: exact below 8, then
+ * four buckets to each power of two, so a percentile read back is within
+ * 25% of the truth over any range. One thread adds; any thread reads,
+ * and may see an add half done, which is fine for metrics. */
+
+#define HISTOGRAM_BUCKETS 252
+
+struct Histogram {
+  std::atomic<long long> count[HISTOGRAM_BUCKETS];
+  std::atomic<long long> total, max;
+};
+
+inline void clearHistogram (Histogram &h)
+{
+  for(int k=0; k<HISTOGRAM_BUCKETS; k++)
+    h.count[k].store(0, std::memory_order_relaxed);
+  h.total.store(0, std::memory_order_relaxed);
+  h.max.store(0, std::memory_order_relaxed);
+}
+
+inline int histogramBucket (long long value)
+{
+  if(value < 8)
+    return value < 0 ? 0 : (int)value;
+  int top = 63 - __builtin_clzll((unsigned long long)value);
+  return 4*(top - 1) + (int)((value >> (top - 2)) & 3);
+}
+
+/* The largest value that lands in bucket k */
+inline long long histogramBucketTop (int k)
+{
+  if(k < 8)
+    return k;
+  int top = k/4 + 1;
+  return ((long long)(4 + k%4) << (top - 2)) + ((1LL << (top - 2)) - 1);
+}
+
+inline void addSample (Histogram &h, long long value)
+{
+  h.count[histogramBucket(value)].fetch_add(1, std::memory_order_relaxed);
+  h.total.fetch_add(1, std::memory_order_relaxed);
+  if(value > h.max.load(std::memory_order_relaxed))
+    h.max.store(value, std::memory_order_relaxed);
+}
+
+/* The value p (0..1) of the samples are at or below, to the bucket; 0 when
+ * there are none */
+inline long long histogramPercentile (const Histogram &h, double p)
+{
+  long long total = h.total.load(std::memory_order_relaxed), seen = 0;
+  if(total == 0)
+    return 0;
+  long long want = (long long)(p * total + 0.5);
+  if(want < 1)
+    want = 1;
+  for(int k=0; k<HISTOGRAM_BUCKETS; k++)
+  {
+    seen += h.count[k].load(std::memory_order_relaxed);
+    if(seen >= want)
+    {
+      long long top = histogramBucketTop(k), max = h.max.load(std::memory_order_relaxed);
+      return top < max ? top : max;
+    }
+  }
+  return h.max.load(std::memory_order_relaxed);
+}
+
+#endif
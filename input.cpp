@@ -0,0 +1,96 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include "input.h"
+
+/* A key bound to an action. With a modifier the action needs both keys
+ * down; a bare binding only counts while no modifier key is down, so
+ * LEFT alone pans while SHIFT+LEFT moves the red basket. */
+struct KeyBinding {
+  int action;
+  int key;
+  int modifier;  // key held along with it, or 0
+  bool bare;
+};
+
+static KeyBinding bindings[] = {
+  { INPUT_RED_LEFT, GLFW_KEY_LEFT, GLFW_KEY_LEFT_SHIFT, false },
+  { INPUT_RED_RIGHT, GLFW_KEY_RIGHT, GLFW_KEY_LEFT_SHIFT, false },
+  { INPUT_GREEN_LEFT, GLFW_KEY_LEFT, GLFW_KEY_LEFT_ALT, false },
+  { INPUT_GREEN_RIGHT, GLFW_KEY_RIGHT, GLFW_KEY_LEFT_ALT, false },
+  { INPUT_SHOOTER_UP, GLFW_KEY_S, 0, false },
+  { INPUT_SHOOTER_DOWN, GLFW_KEY_F, 0, false },
+  { INPUT_AIM_UP, GLFW_KEY_A, 0, false },
+  { INPUT_AIM_DOWN, GLFW_KEY_D, 0, false },
+  { INPUT_ZOOM_IN, GLFW_KEY_UP, 0, false },
+  { INPUT_ZOOM_OUT, GLFW_KEY_DOWN, 0, false },
+  { INPUT_PAN_LEFT, GLFW_KEY_LEFT, 0, true },
+  { INPUT_PAN_RIGHT, GLFW_KEY_RIGHT, 0, true },
+  { INPUT_FIRE, GLFW_KEY_SPACE, 0, false },
+  { INPUT_FALL_FAST, GLFW_KEY_N, 0, false },
+  { INPUT_FALL_SLOW, GLFW_KEY_M, 0, false }
+};
+#define BINDINGS (int)(sizeof(bindings) / sizeof(bindings[0]))
+
+// Actions seen at key events since the last tick
+static unsigned stepped = 0;
+
+void bindKey (int action, int key)
+{
+  for(int k=0; k<BINDINGS; k++)
+  {
+    if(bindings[k].action == action)
+      bindings[k].key = key;
+  }
+}
+
+/* The actions whose keys are down right now; every key is polled once */
+static unsigned pollActions (GLFWwindow* window)
+{
+  bool modifier_down = glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_LEFT_ALT) == GLFW_PRESS;
+  unsigned down = 0;
+  for(int k=0; k<BINDINGS; k++)
+  {
+    const KeyBinding &binding = bindings[k];
+    if(glfwGetKey(window, binding.key) != GLFW_PRESS)
+      continue;
+    if(binding.modifier != 0 && glfwGetKey(window, binding.modifier) != GLFW_PRESS)
+      continue;
+    if(binding.bare && modifier_down)
+      continue;
+    down |= 1u << binding.action;
+  }
+  return down;
+}
+
+/* The GLFW_MOD_ bit a key event carries while modifier is down */
+static int modifierBit (int modifier)
+{
+  return modifier == GLFW_KEY_LEFT_SHIFT ? GLFW_MOD_SHIFT : modifier == GLFW_KEY_LEFT_ALT ? GLFW_MOD_ALT : 0;
+}
+
+void inputKeyEvent (int key, int action, int mods)
+{
+  if(action == GLFW_RELEASE)
+    return;
+  bool modifier_down = (mods & (GLFW_MOD_SHIFT | GLFW_MOD_ALT)) != 0;
+  for(int k=0; k<BINDINGS; k++)
+  {
+    const KeyBinding &binding = bindings[k];
+    if(binding.key != key)
+      continue;
+    if(binding.modifier != 0 && !(mods & modifierBit(binding.modifier)))
+      continue;
+    if(binding.bare && modifier_down)
+      continue;
+    stepped |= 1u << binding.action;
+  }
+}
+
+InputFrame sampleInput (GLFWwindow* window)
+{
+  InputFrame frame;
+  frame.held = pollActions(window);
+  frame.stepped = stepped;
+  stepped = 0;
+  return frame;
+}
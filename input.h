@@ -0,0 +1,56 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+/* Everything the player can do, one bit each in an InputFrame */
+enum InputAction {
+  INPUT_RED_LEFT,      // move the red basket
+  INPUT_RED_RIGHT,
+  INPUT_GREEN_LEFT,    // move the green basket
+  INPUT_GREEN_RIGHT,
+  INPUT_SHOOTER_UP,    // move the shooter
+  INPUT_SHOOTER_DOWN,
+  INPUT_AIM_UP,        // turn the shooter
+  INPUT_AIM_DOWN,
+  INPUT_ZOOM_IN,
+  INPUT_ZOOM_OUT,
+  INPUT_PAN_LEFT,
+  INPUT_PAN_RIGHT,
+  INPUT_FIRE,
+  INPUT_FALL_FAST,     // bricks fall faster / slower while held
+  INPUT_FALL_SLOW,
+  INPUT_ACTIONS
+};
+
+/* The input for one tick, sampled once and read by the simulation.
+ * held has the actions whose keys are down at the tick; stepped has the
+ * ones whose keys were pressed or repeated since the last tick. Stepped actions
+ * (baskets, shooter, camera) move one step per key event, like key repeat;
+ * held ones (fire, fall speed) act every tick the key is down. */
+struct InputFrame {
+  unsigned held;
+  unsigned stepped;
+};
+
+inline bool inputHeld (const InputFrame &frame, int action)
+{
+  return (frame.held >> action) & 1;
+}
+
+inline bool inputStepped (const InputFrame &frame, int action)
+{
+  return (frame.stepped >> action) & 1;
+}
+
+struct GLFWwindow;
+
+/* Point action at a different key */
+void bindKey (int action, int key);
+
+/* Call from the key callback with its key, action and mods: records the
+ * actions bound to that key for the next tick, without polling */
+void inputKeyEvent (int key, int action, int mods);
+
+/* Poll the bindings for the coming tick and take the recorded events */
+InputFrame sampleInput (GLFWwindow* window);
+
+#endif
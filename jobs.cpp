@@ -0,0 +1,196 @@
+#include <cstdlib>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include "jobs.h"
+
+using namespace std;
+
+struct Job {
+  JobFn fn;
+  void *ctx;
+  int first, last, chunk;
+};
+
+/* A deque of jobs in a ring that only grows, so queueing doesn't allocate
+ * once it has held the most jobs it will ever hold */
+struct WorkerQueue {
+  mutex lock;
+  vector<Job> ring;   // power of two size
+  unsigned head;      // front of the deque
+  unsigned count;
+  WorkerQueue () : ring(16), head(0), count(0) {}
+};
+
+static void pushFront (WorkerQueue *queue, const Job &job)
+{
+  if(queue->count == queue->ring.size())
+  {
+    vector<Job> ring(2*queue->ring.size());
+    for(unsigned k=0; k<queue->count; k++)
+      ring[k] = queue->ring[(queue->head + k) & (queue->ring.size()-1)];
+    queue->ring.swap(ring);
+    queue->head = 0;
+  }
+  queue->head = (queue->head - 1) & (queue->ring.size()-1);
+  queue->ring[queue->head] = job;
+  queue->count++;
+}
+
+static vector<WorkerQueue*> queues;  // queues[0] belongs to the calling thread
+static vector<thread> workers;
+static mutex sleep_lock;
+static condition_variable wake;
+static atomic<int> queued(0);        // jobs sitting in any queue
+static atomic<int> pending(0);       // jobs of the running parallelFor not finished yet
+static bool stopping = false;
+static bool registered = false;
+
+static bool popJob (int self, Job &job)
+{
+  WorkerQueue *own = queues[self];
+  {
+    lock_guard<mutex> guard(own->lock);
+    if(own->count > 0)
+    {
+      own->count--;
+      job = own->ring[(own->head + own->count) & (own->ring.size()-1)];
+      queued--;
+      return true;
+    }
+  }
+  // Steal the oldest job of the next queue that has any
+  for(int k=1; k<(int)queues.size(); k++)
+  {
+    WorkerQueue *victim = queues[(self + k) % queues.size()];
+    lock_guard<mutex> guard(victim->lock);
+    if(victim->count > 0)
+    {
+      job = victim->ring[victim->head];
+      victim->head = (victim->head + 1) & (victim->ring.size()-1);
+      victim->count--;
+      queued--;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void runJob (const Job &job)
+{
+  job.fn(job.first, job.last, job.chunk, job.ctx);
+  pending--;
+}
+
+static void workerLoop (int self)
+{
+  Job job;
+  for(;;)
+  {
+    if(popJob(self, job))
+    {
+      runJob(job);
+      continue;
+    }
+    unique_lock<mutex> guard(sleep_lock);
+    wake.wait(guard, [] { return stopping || queued > 0; });
+    if(stopping)
+      return;
+  }
+}
+
+void startJobs (int threads)
+{
+  if(threads <= 0)
+    threads = thread::hardware_concurrency();
+  if(threads <= 0)
+    threads = 1;
+  stopJobs();
+  // exit() must not destroy workers that are still running
+  if(!registered)
+  {
+    atexit(stopJobs);
+    registered = true;
+  }
+  for(int k=0; k<threads; k++)
+    queues.push_back(new WorkerQueue);
+  for(int k=1; k<threads; k++)
+    workers.push_back(thread(workerLoop, k));
+}
+
+void stopJobs ()
+{
+  {
+    lock_guard<mutex> guard(sleep_lock);
+    stopping = true;
+  }
+  wake.notify_all();
+  for(int k=0; k<(int)workers.size(); k++)
+    workers[k].join();
+  workers.clear();
+  for(int k=0; k<(int)queues.size(); k++)
+    delete queues[k];
+  queues.clear();
+  stopping = false;
+}
+
+bool jobsRunning ()
+{
+  return !queues.empty();
+}
+
+int jobThreads ()
+{
+  return queues.empty() ? 1 : queues.size();
+}
+
+int jobChunks (int n, int grain)
+{
+  if(grain < 1)
+    grain = 1;
+  return (n + grain - 1) / grain;
+}
+
+void parallelFor (int n, int grain, JobFn fn, void *ctx)
+{
+  int chunks = jobChunks(n, grain);
+  if(grain < 1)
+    grain = 1;
+  // Not worth waking anyone for a single chunk
+  if(queues.size() <= 1 || chunks <= 1)
+  {
+    for(int c=0; c<chunks; c++)
+      fn(c*grain, min(n, (c+1)*grain), c, ctx);
+    return;
+  }
+
+  // Deal the chunks out in contiguous runs, one run per queue
+  pending += chunks;
+  int per_queue = (chunks + queues.size() - 1) / queues.size();
+  for(int q=0; q<(int)queues.size(); q++)
+  {
+    lock_guard<mutex> guard(queues[q]->lock);
+    for(int c=q*per_queue; c<chunks && c<(q+1)*per_queue; c++)
+    {
+      Job job = { fn, ctx, c*grain, min(n, (c+1)*grain), c };
+      pushFront(queues[q], job);
+      queued++;
+    }
+  }
+  {
+    lock_guard<mutex> guard(sleep_lock);
+  }
+  wake.notify_all();
+
+  // Help out until every chunk has finished, including ones others took
+  Job job;
+  while(pending > 0)
+  {
+    if(popJob(0, job))
+      runJob(job);
+    else
+      this_thread::yield();
+  }
+}
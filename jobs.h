@@ -0,0 +1,33 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+/* Small work-stealing job system.
+ * Each worker owns a deque of jobs: it pops its own jobs from the back and,
+ * when it runs dry, steals from the front of the others. The thread that
+ * calls parallelFor() works through the jobs too until they are all done. */
+
+/* Body of a parallel loop: handles items [first, last), which form chunk
+ * number `chunk` (chunks are numbered in item order from 0) */
+typedef void (*JobFn) (int first, int last, int chunk, void *ctx);
+
+/* Start the workers; threads counts the calling thread, 0 picks one per core */
+void startJobs (int threads);
+
+/* Stop and join the workers */
+void stopJobs ();
+
+/* Whether startJobs() has run since the last stopJobs() */
+bool jobsRunning ();
+
+/* Threads that run jobs, the calling thread included */
+int jobThreads ();
+
+/* Number of chunks parallelFor(n, grain, ...) splits its range into */
+int jobChunks (int n, int grain);
+
+/* Run fn over [0, n) in chunks of grain items and wait for all of them.
+ * Chunks may run in any order on any thread; callers that need a
+ * deterministic result write per chunk and reduce in chunk order. */
+void parallelFor (int n, int grain, JobFn fn, void *ctx);
+
+#endif
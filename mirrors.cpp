@@ -0,0 +1,224 @@
+#include <cmath>
+#include <algorithm>
+#include "mirrors.h"
+
+using namespace std;
+
+Mirror makeMirror (float cx, float cy, float half_len, float angle)
+{
+  Mirror m;
+  m.cx = cx;
+  m.cy = cy;
+  m.half_len = half_len;
+  m.angle = angle;
+  placeMirror(m);
+  return m;
+}
+
+void placeMirror (Mirror &m)
+{
+  float ux = cos(m.angle*M_PI/180.0f), uy = sin(m.angle*M_PI/180.0f);
+  m.x0 = m.cx - ux*m.half_len;
+  m.y0 = m.cy - uy*m.half_len;
+  m.x1 = m.cx + ux*m.half_len;
+  m.y1 = m.cy + uy*m.half_len;
+  m.nx = -uy;
+  m.ny = ux;
+}
+
+/* Distance along the ray to mirror m if it is hit before dist, else -1 */
+static float rayHitsMirror (const Mirror &m, float px, float py, float dx, float dy, float dist)
+{
+  // Solve p + s*d = m0 + v*(m1 - m0) for s along the ray and v along the face
+  float ex = m.x1 - m.x0, ey = m.y1 - m.y0;
+  float denom = dx*ey - dy*ex;
+  if(fabs(denom) < 1e-9f)
+    return -1;  // parallel to the face
+  float wx = m.x0 - px, wy = m.y0 - py;
+  float s = (wx*ey - wy*ex) / denom;
+  float v = (wx*dy - wy*dx) / denom;
+  if(s >= 0 && s <= dist && v >= 0 && v <= 1)
+    return s;
+  return -1;
+}
+
+int firstMirrorHit (const vector<Mirror> &mirrors, float px, float py, float dx, float dy,
+                    float len, int skip, float &dist)
+{
+  int best = -1;
+  dist = len;
+  for(int k=0; k<(int)mirrors.size(); k++)
+  {
+    if(k == skip)
+      continue;
+    float s = rayHitsMirror(mirrors[k], px, py, dx, dy, dist);
+    if(s >= 0 && (best < 0 || s < dist))
+    {
+      best = k;
+      dist = s;
+    }
+  }
+  return best;
+}
+
+/* Mirrors per leaf */
+#define BVH_LEAF_SIZE 4
+
+static void mirrorBounds (const Mirror &m, MirrorBVHNode &node)
+{
+  node.min_x = min(m.x0, m.x1);
+  node.min_y = min(m.y0, m.y1);
+  node.max_x = max(m.x0, m.x1);
+  node.max_y = max(m.y0, m.y1);
+}
+
+static void growBounds (MirrorBVHNode &node, const MirrorBVHNode &other)
+{
+  node.min_x = min(node.min_x, other.min_x);
+  node.min_y = min(node.min_y, other.min_y);
+  node.max_x = max(node.max_x, other.max_x);
+  node.max_y = max(node.max_y, other.max_y);
+}
+
+/* Recompute one node's box from its mirrors or children */
+static void fitNode (MirrorBVH &bvh, const vector<Mirror> &mirrors, int n)
+{
+  MirrorBVHNode &node = bvh.nodes[n];
+  if(node.left >= 0)
+  {
+    MirrorBVHNode box = bvh.nodes[node.left];
+    growBounds(box, bvh.nodes[node.right]);
+    node.min_x = box.min_x;
+    node.min_y = box.min_y;
+    node.max_x = box.max_x;
+    node.max_y = box.max_y;
+    return;
+  }
+  mirrorBounds(mirrors[bvh.order[node.first]], node);
+  for(int k=1; k<node.count; k++)
+  {
+    MirrorBVHNode box;
+    mirrorBounds(mirrors[bvh.order[node.first + k]], box);
+    growBounds(node, box);
+  }
+}
+
+/* Orders mirror indices by centre along one axis */
+struct CentreLess {
+  const vector<Mirror> &mirrors;
+  bool by_x;
+  CentreLess (const vector<Mirror> &m, bool x) : mirrors(m), by_x(x) {}
+  bool operator() (int a, int b) const
+  {
+    return by_x ? mirrors[a].cx < mirrors[b].cx : mirrors[a].cy < mirrors[b].cy;
+  }
+};
+
+/* Split order[first, first+count) at the median centre along the wider axis */
+static int buildNode (MirrorBVH &bvh, const vector<Mirror> &mirrors, int first, int count)
+{
+  int n = bvh.nodes.size();
+  MirrorBVHNode node;
+  node.left = node.right = -1;
+  node.first = first;
+  node.count = count;
+  bvh.nodes.push_back(node);
+  if(count > BVH_LEAF_SIZE)
+  {
+    float lo_x = mirrors[bvh.order[first]].cx, hi_x = lo_x;
+    float lo_y = mirrors[bvh.order[first]].cy, hi_y = lo_y;
+    for(int k=first; k<first+count; k++)
+    {
+      const Mirror &m = mirrors[bvh.order[k]];
+      lo_x = min(lo_x, m.cx);
+      hi_x = max(hi_x, m.cx);
+      lo_y = min(lo_y, m.cy);
+      hi_y = max(hi_y, m.cy);
+    }
+    bool by_x = hi_x - lo_x >= hi_y - lo_y;
+    int half = count / 2;
+    nth_element(bvh.order.begin() + first, bvh.order.begin() + first + half, bvh.order.begin() + first + count,
+                CentreLess(mirrors, by_x));
+    int left = buildNode(bvh, mirrors, first, half);
+    int right = buildNode(bvh, mirrors, first + half, count - half);
+    bvh.nodes[n].left = left;
+    bvh.nodes[n].right = right;
+  }
+  fitNode(bvh, mirrors, n);
+  return n;
+}
+
+void buildMirrorBVH (MirrorBVH &bvh, const vector<Mirror> &mirrors)
+{
+  bvh.nodes.clear();
+  bvh.order.resize(mirrors.size());
+  for(int k=0; k<(int)mirrors.size(); k++)
+    bvh.order[k] = k;
+  if(!mirrors.empty())
+    buildNode(bvh, mirrors, 0, mirrors.size());
+}
+
+void refitMirrorBVH (MirrorBVH &bvh, const vector<Mirror> &mirrors)
+{
+  // Children come after their parent, so a reverse sweep is bottom-up
+  for(int n=bvh.nodes.size()-1; n>=0; n--)
+    fitNode(bvh, mirrors, n);
+}
+
+/* Slab test: does the ray enter the box before dist? */
+static bool rayHitsBox (const MirrorBVHNode &node, float px, float py, float inv_x, float inv_y, float dist)
+{
+  float t0 = (node.min_x - px) * inv_x, t1 = (node.max_x - px) * inv_x;
+  float t_in = min(t0, t1), t_out = max(t0, t1);
+  t0 = (node.min_y - py) * inv_y;
+  t1 = (node.max_y - py) * inv_y;
+  t_in = max(t_in, min(t0, t1));
+  t_out = min(t_out, max(t0, t1));
+  return t_out >= max(t_in, 0.0f) && t_in <= dist;
+}
+
+int firstMirrorHit (const MirrorBVH &bvh, const vector<Mirror> &mirrors, float px, float py,
+                    float dx, float dy, float len, int skip, float &dist)
+{
+  int best = -1;
+  dist = len;
+  if(bvh.nodes.empty())
+    return best;
+  // An axis-parallel ray gets a huge but finite inverse, so 0 * inv stays 0
+  float inv_x = fabs(dx) > 1e-20f ? 1.0f / dx : 1e30f;
+  float inv_y = fabs(dy) > 1e-20f ? 1.0f / dy : 1e30f;
+  int stack[64], top = 0;
+  stack[top++] = 0;
+  while(top > 0)
+  {
+    const MirrorBVHNode &node = bvh.nodes[stack[--top]];
+    if(!rayHitsBox(node, px, py, inv_x, inv_y, dist))
+      continue;
+    if(node.left >= 0)
+    {
+      stack[top++] = node.left;
+      stack[top++] = node.right;
+      continue;
+    }
+    for(int k=node.first; k<node.first+node.count; k++)
+    {
+      int m = bvh.order[k];
+      if(m == skip)
+        continue;
+      float s = rayHitsMirror(mirrors[m], px, py, dx, dy, dist);
+      if(s >= 0 && (best < 0 || s < dist || (s == dist && m < best)))
+      {
+        best = m;
+        dist = s;
+      }
+    }
+  }
+  return best;
+}
+
+void reflectOffMirror (const Mirror &m, float &dx, float &dy)
+{
+  float dot = dx*m.nx + dy*m.ny;
+  dx -= 2*dot*m.nx;
+  dy -= 2*dot*m.ny;
+}
@@ -0,0 +1,55 @@
+#ifndef MIRRORS_H
+#define MIRRORS_H
+
+#include <vector>
+
+/* A mirror is a line segment that reflects lasers off either face */
+struct Mirror {
+  float cx, cy;      // centre
+  float half_len;    // half the length of the reflecting face
+  float angle;       // direction of the face, degrees
+  // Derived by placeMirror()
+  float x0, y0, x1, y1;  // end points
+  float nx, ny;          // unit normal
+};
+
+/* Make a mirror and precompute its end points and normal */
+Mirror makeMirror (float cx, float cy, float half_len, float angle);
+
+/* Recompute the end points and normal after moving or rotating a mirror */
+void placeMirror (Mirror &m);
+
+/* First mirror the ray from (px, py) along unit (dx, dy) crosses within len
+ * units, ignoring mirror skip (the one the ray just left); -1 if none.
+ * dist is set to the distance along the ray. */
+int firstMirrorHit (const std::vector<Mirror> &mirrors, float px, float py, float dx, float dy,
+                    float len, int skip, float &dist);
+
+/* Reflect the unit direction (dx, dy) off the mirror's face */
+void reflectOffMirror (const Mirror &m, float &dx, float &dy);
+
+/* Bounding volume hierarchy over the mirror segments, so a beam step costs
+ * O(log mirrors) instead of O(mirrors). Built once at level load; when
+ * mirrors turn in place only the boxes are refitted, the tree is kept. */
+struct MirrorBVHNode {
+  float min_x, min_y, max_x, max_y;
+  int left, right;      // child nodes, -1 for a leaf
+  int first, count;     // leaf: range in MirrorBVH::order
+};
+
+struct MirrorBVH {
+  std::vector<MirrorBVHNode> nodes;  // children always come after their parent
+  std::vector<int> order;            // mirror indices grouped by leaf
+};
+
+/* Build the hierarchy over all the mirrors */
+void buildMirrorBVH (MirrorBVH &bvh, const std::vector<Mirror> &mirrors);
+
+/* Recompute the boxes after placeMirror() on some of the mirrors */
+void refitMirrorBVH (MirrorBVH &bvh, const std::vector<Mirror> &mirrors);
+
+/* firstMirrorHit() through the hierarchy */
+int firstMirrorHit (const MirrorBVH &bvh, const std::vector<Mirror> &mirrors, float px, float py,
+                    float dx, float dy, float len, int skip, float &dist);
+
+#endif
@@ -0,0 +1,198 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MIX_X86 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MIX_NEON 1
+#endif
+
+#include "mixer.h"
+
+using namespace std;
+
+#define SFX_LEVEL 0.3f   // of full scale, leaving the music room
+
+static void mixScalar (int16_t *out, const int16_t *in, int n)
+{
+  for(int k=0; k<n; k++)
+  {
+    int sum = out[k] + in[k];
+    out[k] = sum > 32767 ? 32767 : sum < -32768 ? -32768 : sum;
+  }
+}
+
+#ifdef MIX_X86
+__attribute__((target("sse2")))
+static void mixSse (int16_t *out, const int16_t *in, int n)
+{
+  int k = 0;
+  for(; k+8<=n; k+=8)
+  {
+    __m128i sum = _mm_adds_epi16(_mm_loadu_si128((const __m128i*)(out+k)), _mm_loadu_si128((const __m128i*)(in+k)));
+    _mm_storeu_si128((__m128i*)(out+k), sum);
+  }
+  mixScalar(out+k, in+k, n-k);
+}
+
+__attribute__((target("avx2")))
+static void mixAvx2 (int16_t *out, const int16_t *in, int n)
+{
+  int k = 0;
+  for(; k+16<=n; k+=16)
+  {
+    __m256i sum = _mm256_adds_epi16(_mm256_loadu_si256((const __m256i*)(out+k)), _mm256_loadu_si256((const __m256i*)(in+k)));
+    _mm256_storeu_si256((__m256i*)(out+k), sum);
+  }
+  mixScalar(out+k, in+k, n-k);
+}
+#endif
+
+#ifdef MIX_NEON
+static void mixNeon (int16_t *out, const int16_t *in, int n)
+{
+  int k = 0;
+  for(; k+8<=n; k+=8)
+    vst1q_s16(out+k, vqaddq_s16(vld1q_s16(out+k), vld1q_s16(in+k)));
+  mixScalar(out+k, in+k, n-k);
+}
+#endif
+
+typedef void (*MixFn) (int16_t*, const int16_t*, int);
+
+static const char *kernel_name = "scalar";
+
+static MixFn pickKernel ()
+{
+#ifdef MIX_X86
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2"))
+  {
+    kernel_name = "avx2";
+    return mixAvx2;
+  }
+  if(__builtin_cpu_supports("sse2"))
+  {
+    kernel_name = "sse2";
+    return mixSse;
+  }
+#endif
+#ifdef MIX_NEON
+  kernel_name = "neon";
+  return mixNeon;
+#endif
+  return mixScalar;
+}
+
+static MixFn kernel = pickKernel();
+
+void mixSaturate (int16_t *out, const int16_t *in, int n)
+{
+  kernel(out, in, n);
+}
+
+const char* mixKernel ()
+{
+  return kernel_name;
+}
+
+/* seconds of wave(t, phase, dt), a level in -1..1 at t seconds in; the
+ * wave keeps its own phase, in cycles, and advances it by dt seconds */
+template <class Wave>
+static void synth (vector<int16_t> &out, long rate, int channels, float seconds, Wave wave)
+{
+  int frames = (int)(seconds * rate);
+  out.resize(frames * channels);
+  double phase = 0;
+  for(int f=0; f<frames; f++)
+  {
+    float t = (float)f / rate;
+    float level = wave(t, phase, (double)1 / rate);
+    int16_t sample = (int16_t)lrintf(fmaxf(-1, fminf(1, level)) * SFX_LEVEL * 32767);
+    for(int c=0; c<channels; c++)
+      out[f*channels + c] = sample;
+  }
+}
+
+/* A short fade in against clicks, then an exponential fade out */
+static float envelope (float t, float decay)
+{
+  return fminf(t / 0.003f, 1) * expf(-t * decay);
+}
+
+void initMixer (Mixer &mixer, long rate, int channels)
+{
+  // Laser: a square wave sweeping down from 1400 Hz
+  synth(mixer.sfx[SFX_FIRE], rate, channels, 0.12f, [](float t, double &phase, double dt) {
+    phase += (1400 - 9000*t) * dt;
+    return (phase - floor(phase) < 0.5 ? 0.6f : -0.6f) * envelope(t, 25);
+  });
+  // Hit: a burst of noise
+  unsigned noise = 0x9e3779b9u;
+  synth(mixer.sfx[SFX_HIT], rate, channels, 0.09f, [&noise](float t, double &phase, double dt) {
+    noise ^= noise << 13;
+    noise ^= noise >> 17;
+    noise ^= noise << 5;
+    return ((int)(noise >> 16) / 32768.0f - 1) * envelope(t, 40);
+  });
+  // Catch: two rising sine notes
+  synth(mixer.sfx[SFX_CATCH], rate, channels, 0.18f, [](float t, double &phase, double dt) {
+    phase += (t < 0.07f ? 660 : 990) * dt;
+    return (float)sin(2*M_PI*phase) * envelope(t < 0.07f ? t : t - 0.07f, 18);
+  });
+  // Game over: three falling triangle notes
+  synth(mixer.sfx[SFX_GAME_OVER], rate, channels, 0.9f, [](float t, double &phase, double dt) {
+    int note = min((int)(t / 0.3f), 2);
+    static const float pitch[3] = { 392, 330, 262 };
+    phase += pitch[note] * dt;
+    float saw = phase - floor(phase);
+    return (4*fabsf(saw - 0.5f) - 1) * envelope(t - note*0.3f, 5);
+  });
+  memset(mixer.voices, 0, sizeof(mixer.voices));
+  mixer.started = mixer.stolen = 0;
+}
+
+void startVoice (Mixer &mixer, int sfx)
+{
+  if(sfx < 0 || sfx >= SFX_COUNT || mixer.sfx[sfx].empty())
+    return;
+  int pick = 0;
+  for(int v=0; v<MIX_VOICES; v++)
+  {
+    if(!mixer.voices[v].at)
+    {
+      pick = v;
+      break;
+    }
+    if(mixer.voices[v].left < mixer.voices[pick].left)
+      pick = v;
+  }
+  if(mixer.voices[pick].at)
+    mixer.stolen++;
+  mixer.voices[pick].at = &mixer.sfx[sfx][0];
+  mixer.voices[pick].left = mixer.sfx[sfx].size();
+  mixer.started++;
+}
+
+int mixVoices (Mixer &mixer, int16_t *out, int samples)
+{
+  int playing = 0;
+  for(int v=0; v<MIX_VOICES; v++)
+  {
+    Voice &voice = mixer.voices[v];
+    if(!voice.at)
+      continue;
+    int n = min(voice.left, samples);
+    mixSaturate(out, voice.at, n);
+    voice.at += n;
+    voice.left -= n;
+    if(voice.left == 0)
+      voice.at = NULL;
+    else
+      playing++;
+  }
+  return playing;
+}
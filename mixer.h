@@ -0,0 +1,50 @@
+#ifndef MIXER_H
+#define MIXER_H
+
+#include <vector>
+#include <stdint.h>
+
+/* Sound effects over the music. The effects are synthesized once, at the
+ * device's rate and channel count, into signed 16 bit samples; playing one
+ * takes a voice from a fixed pool and mixing is a saturating add of each
+ * voice into the block, with the widest SIMD the CPU has. Nothing here
+ * allocates once initMixer() has run. */
+
+enum SfxId {
+  SFX_FIRE,
+  SFX_HIT,
+  SFX_CATCH,
+  SFX_GAME_OVER,
+  SFX_COUNT
+};
+
+#define MIX_VOICES 16
+
+struct Voice {
+  const int16_t *at;   // next sample, NULL when idle
+  int left;            // samples still to mix
+};
+
+struct Mixer {
+  std::vector<int16_t> sfx[SFX_COUNT];  // interleaved like the music
+  Voice voices[MIX_VOICES];
+  long long started, stolen;            // voices started; started by cutting one short
+};
+
+/* Synthesize the effects for the device format and silence every voice */
+void initMixer (Mixer &mixer, long rate, int channels);
+
+/* Start sfx from the top; with every voice busy, the one nearest its end
+ * gives way */
+void startVoice (Mixer &mixer, int sfx);
+
+/* Add every playing voice into the samples of out; returns how many play on */
+int mixVoices (Mixer &mixer, int16_t *out, int samples);
+
+/* out[k] += in[k] for n samples, clamped to int16 */
+void mixSaturate (int16_t *out, const int16_t *in, int n);
+
+/* Name of the kernel mixSaturate dispatches to */
+const char* mixKernel ();
+
+#endif
@@ -0,0 +1,99 @@
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "mp3map.h"
+
+#define PREFETCH_BYTES (256*1024)   // asked for ahead of the reader
+
+bool mapMp3 (const char *path, Mp3Map &map)
+{
+  map.data = NULL;
+  map.size = 0;
+  int fd = open(path, O_RDONLY);
+  if(fd < 0)
+    return false;
+  struct stat info;
+  if(fstat(fd, &info) < 0 || !S_ISREG(info.st_mode) || info.st_size == 0)
+  {
+    close(fd);
+    return false;
+  }
+  void *memory = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(memory == MAP_FAILED)
+    return false;
+  // Read front to back: the kernel may read ahead harder and drop pages
+  // behind sooner
+  madvise(memory, info.st_size, MADV_SEQUENTIAL);
+  map.data = (const unsigned char*)memory;
+  map.size = info.st_size;
+  return true;
+}
+
+void unmapMp3 (Mp3Map &map)
+{
+  if(map.data)
+    munmap((void*)map.data, map.size);
+  map.data = NULL;
+  map.size = 0;
+}
+
+/* Ask for the pages from the reader on to PREFETCH_BYTES past it, once
+ * it is half way through what was asked for last */
+static void prefetch (Mp3Reader &reader)
+{
+  const Mp3Map &map = *reader.map;
+  if(reader.at + PREFETCH_BYTES/2 < reader.prefetched || reader.prefetched >= map.size)
+    return;
+  static const size_t page = sysconf(_SC_PAGESIZE);
+  size_t from = reader.prefetched > reader.at ? reader.prefetched : reader.at;
+  from &= ~(page - 1);
+  size_t to = reader.at + PREFETCH_BYTES;
+  if(to > map.size)
+    to = map.size;
+  if(to > from)
+    madvise((void*)(map.data + from), to - from, MADV_WILLNEED);
+  reader.prefetched = to;
+}
+
+static ssize_t readMapped (void *handle, void *buffer, size_t count)
+{
+  Mp3Reader &reader = *(Mp3Reader*)handle;
+  const Mp3Map &map = *reader.map;
+  if(reader.at >= map.size)
+    return 0;
+  if(count > map.size - reader.at)
+    count = map.size - reader.at;
+  prefetch(reader);
+  memcpy(buffer, map.data + reader.at, count);
+  reader.at += count;
+  return count;
+}
+
+static off_t seekMapped (void *handle, off_t offset, int whence)
+{
+  Mp3Reader &reader = *(Mp3Reader*)handle;
+  off_t base = whence == SEEK_SET ? 0 : whence == SEEK_CUR ? (off_t)reader.at : (off_t)reader.map->size;
+  off_t at = base + offset;
+  if(at < 0 || at > (off_t)reader.map->size)
+    return -1;
+  reader.at = at;
+  // Looping back to the start: what was asked for may since have gone
+  if(reader.at < reader.prefetched)
+    reader.prefetched = reader.at;
+  return at;
+}
+
+int openMappedMp3 (mpg123_handle *mh, const Mp3Map &map, Mp3Reader &reader)
+{
+  reader.map = &map;
+  reader.at = 0;
+  reader.prefetched = 0;
+  int err = mpg123_replace_reader_handle(mh, readMapped, seekMapped, NULL);
+  if(err != MPG123_OK)
+    return err;
+  return mpg123_open_handle(mh, &reader);
+}
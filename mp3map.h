@@ -0,0 +1,34 @@
+#ifndef MP3MAP_H
+#define MP3MAP_H
+
+#include <stddef.h>
+#include <mpg123.h>
+
+/* The music file mapped into memory and handed to mpg123 through its
+ * replaceable reader, so streaming it is a memcpy out of the page cache
+ * rather than a read() per chunk. The reader asks the kernel for the
+ * pages a little ahead of where it is, so the decoder rarely faults. */
+
+struct Mp3Map {
+  const unsigned char *data;
+  size_t size;
+};
+
+/* One handle's position in a mapping; several can share the mapping */
+struct Mp3Reader {
+  const Mp3Map *map;
+  size_t at;
+  size_t prefetched;   // bytes from the start already asked for
+};
+
+/* Map path read only; false for a file that can't be mapped, such as an
+ * empty one or a pipe */
+bool mapMp3 (const char *path, Mp3Map &map);
+
+void unmapMp3 (Mp3Map &map);
+
+/* mpg123_open() on mh, but reading the mapping through reader, which must
+ * outlive mh's use of it; returns what mpg123_open_handle() does */
+int openMappedMp3 (mpg123_handle *mh, const Mp3Map &map, Mp3Reader &reader);
+
+#endif
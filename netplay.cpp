@@ -0,0 +1,242 @@
+#include <cstring>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include "netplay.h"
+
+using namespace std;
+
+/* A packet: magic, the shooter's seed, how many frames of the receiver the
+ * sender has, then the sender's frames from tick first on, held and stepped
+ * as 16 bits each. Little endian throughout. */
+static const unsigned char MAGIC[4] = { 'B', 'B', 'N', 'P' };
+#define HEADER_BYTES (4 + 8 + 4 + 4 + 2)
+#define PACKET_BYTES (HEADER_BYTES + 4*NET_WINDOW)
+
+static void put (unsigned char *&out, uint64_t value, int bytes)
+{
+  for(int k=0; k<bytes; k++)
+    *out++ = (unsigned char)(value >> (8*k));
+}
+
+static uint64_t get (const unsigned char *&in, int bytes)
+{
+  uint64_t value = 0;
+  for(int k=0; k<bytes; k++)
+    value |= (uint64_t)*in++ << (8*k);
+  return value;
+}
+
+unsigned netRoleActions (int role)
+{
+  if(role == NET_SHOOTER)
+    return 1u << INPUT_SHOOTER_UP | 1u << INPUT_SHOOTER_DOWN | 1u << INPUT_AIM_UP | 1u << INPUT_AIM_DOWN |
+           1u << INPUT_FIRE;
+  return 1u << INPUT_RED_LEFT | 1u << INPUT_RED_RIGHT | 1u << INPUT_GREEN_LEFT | 1u << INPUT_GREEN_RIGHT |
+         1u << INPUT_FALL_FAST | 1u << INPUT_FALL_SLOW;
+}
+
+/* Until its frame arrives, the other side keeps holding what it held last
+ * and steps nothing */
+static InputFrame guessRemote (const NetSession &net)
+{
+  InputFrame guess = { 0, 0 };
+  if(net.remote_count > 0)
+    guess.held = net.input[1-net.role][(net.remote_count-1) % NET_RING].held;
+  return guess;
+}
+
+/* Run tick t from the world as it stands, keeping the state before it */
+static void runTick (NetSession &net, int t)
+{
+  World &world = *net.world;
+  saveWorld(world, net.snapshots[t % NET_WINDOW]);
+  const InputFrame &shooter = net.input[NET_SHOOTER][t % NET_RING];
+  const InputFrame &baskets = net.input[NET_BASKETS][t % NET_RING];
+  unsigned shooter_bits = netRoleActions(NET_SHOOTER), baskets_bits = netRoleActions(NET_BASKETS);
+  InputFrame input;
+  input.held = (shooter.held & shooter_bits) | (baskets.held & baskets_bits);
+  input.stepped = (shooter.stepped & shooter_bits) | (baskets.stepped & baskets_bits);
+  stepWorld(world, input);
+  net.events[t % NET_WINDOW] = world.events;
+}
+
+bool netOpen (NetSession &net, World &world, int role, int port, const char *host, int peer_port, uint64_t seed)
+{
+  net.world = &world;
+  net.role = role;
+  net.seed = seed;
+  net.started = false;
+  net.tick = net.remote_count = net.remote_acked = net.reported = net.rollback_from = 0;
+  memset(net.input, 0, sizeof(net.input));
+  net.rollbacks = net.resimulated = net.stalls = net.packets_sent = net.packets_received = 0;
+  if(role == NET_SHOOTER)
+    resetWorld(world, seed);
+
+  char service[16];
+  snprintf(service, sizeof(service), "%d", peer_port);
+  struct addrinfo hints, *found;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+  if(getaddrinfo(host, service, &hints, &found) != 0)
+    return false;
+  memcpy(net.peer, found->ai_addr, found->ai_addrlen);
+  net.peer_len = found->ai_addrlen;
+  freeaddrinfo(found);
+
+  net.sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if(net.sock < 0)
+    return false;
+  struct sockaddr_in local;
+  memset(&local, 0, sizeof(local));
+  local.sin_family = AF_INET;
+  local.sin_addr.s_addr = htonl(INADDR_ANY);
+  local.sin_port = htons(port);
+  if(bind(net.sock, (struct sockaddr*)&local, sizeof(local)) < 0 ||
+     fcntl(net.sock, F_SETFL, fcntl(net.sock, F_GETFL) | O_NONBLOCK) < 0)
+  {
+    close(net.sock);
+    net.sock = -1;
+    return false;
+  }
+  return true;
+}
+
+void netClose (NetSession &net)
+{
+  if(net.sock < 0)
+    return;
+  // The last frames again, so the other side can confirm the ticks we did
+  for(int k=0; k<3; k++)
+    netSend(net);
+  close(net.sock);
+  net.sock = -1;
+}
+
+/* Take in one packet; marks the earliest tick that ran on a wrong guess */
+static void readPacket (NetSession &net, const unsigned char *in, int length)
+{
+  if(length < HEADER_BYTES || memcmp(in, MAGIC, 4) != 0)
+    return;
+  in += 4;
+  uint64_t seed = get(in, 8);
+  int acked = (int)get(in, 4);
+  int first = (int)get(in, 4);
+  int count = (int)get(in, 2);
+  if(count > NET_WINDOW || length < HEADER_BYTES + 4*count)
+    return;
+  net.packets_received++;
+  if(!net.started)
+  {
+    if(net.role == NET_BASKETS)
+    {
+      // Only the shooter's seed counts, and it comes with its first packet
+      net.seed = seed;
+      resetWorld(*net.world, seed);
+    }
+    net.started = true;
+  }
+  if(acked > net.remote_acked && acked <= net.tick)
+    net.remote_acked = acked;
+
+  InputFrame *remote = net.input[1-net.role];
+  for(int k=0; k<count; k++)
+  {
+    int t = first + k;
+    InputFrame frame;
+    frame.held = (unsigned)get(in, 2);
+    frame.stepped = (unsigned)get(in, 2);
+    // Frames come again until acknowledged; only the next one in order is new
+    if(t != net.remote_count)
+      continue;
+    InputFrame &slot = remote[t % NET_RING];
+    if(t < net.tick && (slot.held != frame.held || slot.stepped != frame.stepped) && t < net.rollback_from)
+      net.rollback_from = t;
+    slot = frame;
+    net.remote_count++;
+  }
+}
+
+void netReceive (NetSession &net)
+{
+  unsigned char packet[PACKET_BYTES];
+  net.rollback_from = net.tick;
+  for(;;)
+  {
+    int length = recv(net.sock, packet, sizeof(packet), 0);
+    if(length < 0)
+      break;
+    readPacket(net, packet, length);
+  }
+  if(net.rollback_from >= net.tick)
+    return;
+
+  // Guesses after the frames that came in follow the newest of them
+  InputFrame guess = guessRemote(net);
+  for(int t=net.remote_count; t<net.tick; t++)
+    net.input[1-net.role][t % NET_RING] = guess;
+  restoreWorld(*net.world, net.snapshots[net.rollback_from % NET_WINDOW]);
+  for(int t=net.rollback_from; t<net.tick; t++)
+    runTick(net, t);
+  net.rollbacks++;
+  net.resimulated += net.tick - net.rollback_from;
+  net.rollback_from = net.tick;
+}
+
+void netSend (NetSession &net)
+{
+  unsigned char packet[PACKET_BYTES], *out = packet;
+  int count = net.tick - net.remote_acked;
+  memcpy(out, MAGIC, 4);
+  out += 4;
+  put(out, net.seed, 8);
+  put(out, net.remote_count, 4);
+  put(out, net.remote_acked, 4);
+  put(out, count, 2);
+  const InputFrame *local = net.input[net.role];
+  for(int t=net.remote_acked; t<net.tick; t++)
+  {
+    put(out, local[t % NET_RING].held, 2);
+    put(out, local[t % NET_RING].stepped, 2);
+  }
+  if(sendto(net.sock, packet, out - packet, 0, (struct sockaddr*)net.peer, net.peer_len) > 0)
+    net.packets_sent++;
+}
+
+bool netCanAdvance (NetSession &net)
+{
+  // A snapshot must be left for every tick a frame can still correct, and a
+  // packet must hold every frame the other side hasn't acknowledged
+  if(net.started && net.tick - net.remote_count < NET_WINDOW - 1 && net.tick - net.remote_acked < NET_WINDOW)
+    return true;
+  net.stalls++;
+  return false;
+}
+
+void netAdvance (NetSession &net, const InputFrame &local)
+{
+  unsigned bits = netRoleActions(net.role);
+  InputFrame &mine = net.input[net.role][net.tick % NET_RING];
+  mine.held = local.held & bits;
+  mine.stepped = local.stepped & bits;
+  if(net.tick >= net.remote_count)
+    net.input[1-net.role][net.tick % NET_RING] = guessRemote(net);
+  runTick(net, net.tick);
+  net.tick++;
+}
+
+void netFinalEvents (NetSession &net, vector<WorldEvent> &out)
+{
+  int final = min(net.tick, net.remote_count);
+  for(; net.reported < final; net.reported++)
+  {
+    const vector<WorldEvent> &events = net.events[net.reported % NET_WINDOW];
+    out.insert(out.end(), events.begin(), events.end());
+  }
+}
@@ -0,0 +1,80 @@
+#ifndef NETPLAY_H
+#define NETPLAY_H
+
+#include <vector>
+#include <stdint.h>
+#include "world.h"
+
+/* Two players over UDP, one on the shooter and one on the baskets, with
+ * rollback: each side runs the game at once on its own input and a guess
+ * of the other's (the keys it last held, no steps), so local input is seen
+ * the very next tick. Every packet repeats the frames the peer hasn't
+ * acknowledged, so lost packets cost nothing but a little delay. When the
+ * peer's real frame for a tick differs from the guess, the game is
+ * restored to its snapshot from before that tick and run forward again.
+ *
+ * Both sides play the shooter's seed. Only events from ticks both inputs
+ * are known for are handed out, so scores and game over never flicker. */
+
+enum NetRole {
+  NET_SHOOTER,   // shooter height and aim, fire
+  NET_BASKETS    // both baskets and the fall speed
+};
+
+/* Ticks a side may run ahead of the last input it has from the other */
+#define NET_WINDOW 64
+/* Input slots kept per side; twice the window, so frames from a peer up
+ * to a window ahead never overwrite ones a rollback still needs */
+#define NET_RING (2*NET_WINDOW)
+
+struct NetSession {
+  int sock;
+  unsigned char peer[32];    // sockaddr of the other side
+  int peer_len;
+  int role;
+  uint64_t seed;
+  bool started;              // heard from the other side
+  World *world;
+
+  int tick;                  // next tick to run
+  int remote_count;          // frames of the other side received, in order
+  int remote_acked;          // frames of ours the other side has
+  int reported;              // ticks whose events were handed out
+  int rollback_from;         // earliest tick run on a wrong guess, or tick
+  InputFrame input[2][NET_RING];          // per role, real or guessed
+  WorldSnapshot snapshots[NET_WINDOW];    // state before each tick
+  std::vector<WorldEvent> events[NET_WINDOW];
+
+  // Counters for the end of the game
+  int rollbacks, resimulated, stalls, packets_sent, packets_received;
+};
+
+/* Listen on port and play against host:peer_port. The shooter side resets
+ * world to seed; the baskets side resets it to the seed the shooter sends.
+ * False if the socket can't be set up. */
+bool netOpen (NetSession &net, World &world, int role, int port, const char *host, int peer_port, uint64_t seed);
+
+void netClose (NetSession &net);
+
+/* Read every packet waiting, then roll back if a guess was wrong */
+void netReceive (NetSession &net);
+
+/* Send the frames the other side hasn't acknowledged */
+void netSend (NetSession &net);
+
+/* Whether the next tick can run, i.e. the other side is there and not a
+ * window behind */
+bool netCanAdvance (NetSession &net);
+
+/* Run the next tick with this side's input; the other side's bits of it
+ * are ignored */
+void netAdvance (NetSession &net, const InputFrame &local);
+
+/* Events of ticks that became final since the last call, in tick order;
+ * call it every frame, only a window of ticks is kept */
+void netFinalEvents (NetSession &net, std::vector<WorldEvent> &out);
+
+/* Input bits each role controls */
+unsigned netRoleActions (int role);
+
+#endif
@@ -0,0 +1,146 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <mpg123.h>
+#include "pcmcache.h"
+
+using namespace std;
+
+static const uint32_t CACHE_MAGIC = 0x43504242;  // "BBPC"
+static const uint32_t CACHE_VERSION = 2;
+
+struct CacheHeader {
+  uint32_t magic, version;
+  uint64_t hash, bytes;
+  int32_t rate, channels, encoding, spare;
+};
+
+uint64_t hashBytes (const unsigned char *bytes, size_t size)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  for(size_t i=0; i<size; i++)
+    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+  return hash;
+}
+
+string pcmCachePath (const char *mp3, uint64_t hash)
+{
+  char name[32];
+  snprintf(name, sizeof(name), ".%016llx.pcm", (unsigned long long)hash);
+  return string(mp3) + name;
+}
+
+bool openPcmCache (const char *mp3, uint64_t hash, PcmCache &cache)
+{
+  memset(&cache, 0, sizeof(cache));
+  int fd = open(pcmCachePath(mp3, hash).c_str(), O_RDONLY);
+  if(fd < 0)
+    return false;
+  struct stat info;
+  if(fstat(fd, &info) < 0 || info.st_size < (off_t)sizeof(CacheHeader))
+  {
+    close(fd);
+    return false;
+  }
+  void *map = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(map == MAP_FAILED)
+    return false;
+  const CacheHeader *header = (const CacheHeader*)map;
+  // Only 16 bit samples, which are all the mixer adds effects to
+  if(header->magic != CACHE_MAGIC || header->version != CACHE_VERSION || header->hash != hash ||
+     header->bytes == 0 || header->bytes != info.st_size - sizeof(CacheHeader) || header->encoding != MPG123_ENC_SIGNED_16)
+  {
+    munmap(map, info.st_size);
+    return false;
+  }
+  // It is played front to back, over and over
+  madvise(map, info.st_size, MADV_SEQUENTIAL);
+  cache.pcm = (const unsigned char*)map + sizeof(CacheHeader);
+  cache.bytes = header->bytes;
+  cache.rate = header->rate;
+  cache.channels = header->channels;
+  cache.encoding = header->encoding;
+  cache.map = map;
+  cache.map_size = info.st_size;
+  return true;
+}
+
+void closePcmCache (PcmCache &cache)
+{
+  if(cache.map)
+    munmap(cache.map, cache.map_size);
+  memset(&cache, 0, sizeof(cache));
+}
+
+bool buildPcmCache (const char *mp3, const Mp3Map &map, uint64_t hash, const atomic<bool> &cancel)
+{
+  int err;
+  mpg123_handle *mh = mpg123_new(NULL, &err);
+  Mp3Reader reader;
+  CacheHeader header;
+  memset(&header, 0, sizeof(header));
+  long rate;
+  int channels, encoding;
+  if(!mh || openMappedMp3(mh, map, reader) != MPG123_OK || mpg123_getformat(mh, &rate, &channels, &encoding) != MPG123_OK)
+  {
+    if(mh)
+      mpg123_delete(mh);
+    return false;
+  }
+  // One format throughout, the same one audio.cpp holds the live decoder to
+  encoding = MPG123_ENC_SIGNED_16;
+  mpg123_format_none(mh);
+  mpg123_format(mh, rate, channels, encoding);
+
+  // Written under a name of our own and renamed when whole, so a reader
+  // never maps half a cache and two games starting at once don't collide
+  string path = pcmCachePath(mp3, hash);
+  char suffix[32];
+  snprintf(suffix, sizeof(suffix), ".%d.tmp", (int)getpid());
+  string temp = path + suffix;
+  FILE *file = fopen(temp.c_str(), "wb");
+  bool ok = file && fwrite(&header, sizeof(header), 1, file) == 1;
+  vector<unsigned char> chunk(65536);
+  uint64_t bytes = 0;
+  while(ok && !cancel.load(memory_order_relaxed))
+  {
+    size_t done = 0;
+    err = mpg123_read(mh, &chunk[0], chunk.size(), &done);
+    if(done > 0)
+    {
+      ok = fwrite(&chunk[0], 1, done, file) == done;
+      bytes += done;
+    }
+    if(err == MPG123_DONE)
+      break;
+    if(err != MPG123_OK && err != MPG123_NEW_FORMAT)
+      ok = false;
+  }
+  mpg123_close(mh);
+  mpg123_delete(mh);
+
+  ok = ok && !cancel.load(memory_order_relaxed) && bytes > 0;
+  if(ok)
+  {
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.hash = hash;
+    header.bytes = bytes;
+    header.rate = rate;
+    header.channels = channels;
+    header.encoding = encoding;
+    ok = fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+  }
+  if(file && fclose(file) != 0)
+    ok = false;
+  if(ok)
+    ok = rename(temp.c_str(), path.c_str()) == 0;
+  if(!ok)
+    remove(temp.c_str());
+  return ok;
+}
@@ -0,0 +1,39 @@
+#ifndef PCMCACHE_H
+#define PCMCACHE_H
+
+#include <atomic>
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+#include "mp3map.h"
+
+/* The music decoded once into a raw PCM file next to the MP3, named after
+ * a hash of the MP3 so an edited file never plays a stale cache. Later
+ * runs map the cache instead of decoding anything. */
+
+struct PcmCache {
+  const unsigned char *pcm;  // the whole track, in the format below
+  size_t bytes;
+  long rate;
+  int channels, encoding;    // as mpg123 reports them
+  void *map;                 // the mapped file, header and all
+  size_t map_size;
+};
+
+/* FNV-1a of bytes; what a cache is keyed by */
+uint64_t hashBytes (const unsigned char *bytes, size_t size);
+
+/* Where the cache of mp3 with that hash lives */
+std::string pcmCachePath (const char *mp3, uint64_t hash);
+
+/* Map the cache of mp3 if a complete one of 16 bit samples is there */
+bool openPcmCache (const char *mp3, uint64_t hash, PcmCache &cache);
+
+void closePcmCache (PcmCache &cache);
+
+/* Decode all of mp3, mapped as map, into its cache, as fast as it goes.
+ * Gives up, leaving nothing behind, if cancel turns true. mpg123_init()
+ * must have run. */
+bool buildPcmCache (const char *mp3, const Mp3Map &map, uint64_t hash, const std::atomic<bool> &cancel);
+
+#endif
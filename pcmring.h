@@ -0,0 +1,78 @@
+#ifndef PCMRING_H
+#define PCMRING_H
+
+#include <atomic>
+#include <vector>
+#include <cstring>
+#include <stddef.h>
+
+/* A ring of PCM bytes between exactly two threads, one writing and one
+ * reading, without locks: each side moves only its own count and reads
+ * the other's. The counts run on forever and the ring size is a power of
+ * two, so the position in it is a mask away and full and empty never look
+ * alike. Each count sits on its own cache line, so the two sides don't
+ * keep taking the line from each other. */
+struct PcmRing {
+  std::vector<unsigned char> data;
+  size_t mask;
+  alignas(64) std::atomic<size_t> written;  // bytes ever written
+  alignas(64) std::atomic<size_t> taken;    // bytes ever read
+};
+
+/* Room for at least bytes; only before either side runs */
+inline void initRing (PcmRing &ring, size_t bytes)
+{
+  size_t size = 64;
+  while(size < bytes)
+    size *= 2;
+  ring.data.assign(size, 0);
+  ring.mask = size - 1;
+  ring.written.store(0, std::memory_order_relaxed);
+  ring.taken.store(0, std::memory_order_relaxed);
+}
+
+/* Bytes waiting, as the reader sees them */
+inline size_t ringFilled (const PcmRing &ring)
+{
+  return ring.written.load(std::memory_order_acquire) - ring.taken.load(std::memory_order_relaxed);
+}
+
+/* Bytes that would fit, as the writer sees them */
+inline size_t ringRoom (const PcmRing &ring)
+{
+  return ring.data.size() - (ring.written.load(std::memory_order_relaxed) - ring.taken.load(std::memory_order_acquire));
+}
+
+/* Write as much of bytes as there is room for; returns how much */
+inline size_t writeRing (PcmRing &ring, const unsigned char *bytes, size_t count)
+{
+  size_t written = ring.written.load(std::memory_order_relaxed);
+  size_t room = ring.data.size() - (written - ring.taken.load(std::memory_order_acquire));
+  if(count > room)
+    count = room;
+  size_t at = written & ring.mask, first = ring.data.size() - at;
+  if(first > count)
+    first = count;
+  memcpy(&ring.data[at], bytes, first);
+  memcpy(&ring.data[0], bytes + first, count - first);
+  ring.written.store(written + count, std::memory_order_release);
+  return count;
+}
+
+/* Read up to count bytes; returns how many there were */
+inline size_t readRing (PcmRing &ring, unsigned char *bytes, size_t count)
+{
+  size_t taken = ring.taken.load(std::memory_order_relaxed);
+  size_t filled = ring.written.load(std::memory_order_acquire) - taken;
+  if(count > filled)
+    count = filled;
+  size_t at = taken & ring.mask, first = ring.data.size() - at;
+  if(first > count)
+    first = count;
+  memcpy(bytes, &ring.data[at], first);
+  memcpy(bytes + first, &ring.data[0], count - first);
+  ring.taken.store(taken + count, std::memory_order_release);
+  return count;
+}
+
+#endif
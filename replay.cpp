@@ -0,0 +1,115 @@
+#include <cstring>
+#include "replay.h"
+
+using namespace std;
+
+static const char MAGIC[4] = { 'B', 'B', 'R', 'P' };
+#define REPLAY_VERSION 1
+
+static void putVarint (FILE *file, uint64_t value)
+{
+  while(value >= 0x80)
+  {
+    fputc((int)(value & 0x7f) | 0x80, file);
+    value >>= 7;
+  }
+  fputc((int)value, file);
+}
+
+/* False if the data runs out or the varint is longer than 64 bits */
+static bool getVarint (InputReplay &replay, uint64_t &value)
+{
+  value = 0;
+  for(int shift=0; shift<64; shift+=7)
+  {
+    if(replay.pos >= replay.data.size())
+      return false;
+    unsigned char byte = replay.data[replay.pos++];
+    value |= (uint64_t)(byte & 0x7f) << shift;
+    if(!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+static void writeRun (InputRecorder &recorder)
+{
+  putVarint(recorder.file, recorder.run);
+  putVarint(recorder.file, recorder.frame.held ^ recorder.held);
+  putVarint(recorder.file, recorder.frame.stepped);
+  recorder.held = recorder.frame.held;
+}
+
+bool startRecording (InputRecorder &recorder, const char *path, uint64_t seed)
+{
+  recorder.file = fopen(path, "wb");
+  if(!recorder.file)
+    return false;
+  fwrite(MAGIC, 1, 4, recorder.file);
+  fputc(REPLAY_VERSION, recorder.file);
+  putVarint(recorder.file, seed);
+  recorder.run = 0;
+  recorder.held = 0;
+  return true;
+}
+
+void recordInput (InputRecorder &recorder, const InputFrame &frame)
+{
+  if(!recorder.file)
+    return;
+  if(recorder.run > 0 && frame.held == recorder.frame.held && frame.stepped == recorder.frame.stepped)
+  {
+    recorder.run++;
+    return;
+  }
+  if(recorder.run > 0)
+    writeRun(recorder);
+  recorder.frame = frame;
+  recorder.run = 1;
+}
+
+void stopRecording (InputRecorder &recorder)
+{
+  if(!recorder.file)
+    return;
+  if(recorder.run > 0)
+    writeRun(recorder);
+  fclose(recorder.file);
+  recorder.file = NULL;
+}
+
+bool loadReplay (InputReplay &replay, const char *path)
+{
+  FILE *file = fopen(path, "rb");
+  if(!file)
+    return false;
+  unsigned char chunk[4096];
+  size_t got;
+  replay.data.clear();
+  while((got = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    replay.data.insert(replay.data.end(), chunk, chunk + got);
+  fclose(file);
+
+  if(replay.data.size() < 5 || memcmp(&replay.data[0], MAGIC, 4) != 0 || replay.data[4] != REPLAY_VERSION)
+    return false;
+  replay.pos = 5;
+  replay.left = 0;
+  replay.frame.held = 0;
+  return getVarint(replay, replay.seed);
+}
+
+bool replayInput (InputReplay &replay, InputFrame &frame)
+{
+  if(replay.left == 0)
+  {
+    uint64_t run, held, stepped;
+    if(!getVarint(replay, run) || !getVarint(replay, held) || !getVarint(replay, stepped) || run == 0)
+      return false;
+    replay.left = run;
+    replay.frame.held ^= held;
+    replay.frame.stepped = stepped;
+  }
+  replay.left--;
+  frame = replay.frame;
+  return true;
+}
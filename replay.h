@@ -0,0 +1,51 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstdio>
+#include <vector>
+#include <stdint.h>
+#include "input.h"
+
+/* Recorded games. A World plays the same for the same seed and InputFrames,
+ * so a recording is the seed and one frame per tick, which replays the
+ * session tick for tick (baskets, shooter, shots, fall speed).
+ *
+ * File: "BBRP", a format version byte, the seed, then runs of identical
+ * frames until the end of the file. Each run is three varints (LEB128):
+ * its length in ticks, held XOR the previous run's held, and stepped.
+ * Keys change a few times a second at most, so a tick costs well under a
+ * byte. */
+
+struct InputRecorder {
+  FILE *file;
+  InputFrame frame;   // frame of the run being counted
+  unsigned run;       // its length so far, 0 before the first tick
+  unsigned held;      // held of the last run written
+  InputRecorder () : file(NULL), run(0), held(0) {}
+};
+
+/* Start recording to path; false if it can't be created */
+bool startRecording (InputRecorder &recorder, const char *path, uint64_t seed);
+
+/* Add the frame of the next tick */
+void recordInput (InputRecorder &recorder, const InputFrame &frame);
+
+/* Write what is pending and close the file */
+void stopRecording (InputRecorder &recorder);
+
+struct InputReplay {
+  std::vector<unsigned char> data;
+  size_t pos;
+  uint64_t seed;
+  InputFrame frame;   // frame of the current run
+  unsigned left;      // ticks left in it
+  InputReplay () : pos(0), seed(0), left(0) {}
+};
+
+/* Read a recording; false if it can't be read or isn't one */
+bool loadReplay (InputReplay &replay, const char *path);
+
+/* Frame of the next tick; false once the recording is over */
+bool replayInput (InputReplay &replay, InputFrame &frame);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+/* xoshiro256** by Blackman and Vigna: small, fast and good enough for
+ * games. Each World owns one, so worlds are reproducible from their seed
+ * and don't share any state when they run on different threads. */
+struct Rng {
+  uint64_t s[4];
+};
+
+/* Fill the state from one 64-bit seed with splitmix64, as the authors
+ * recommend; any seed, 0 included, gives a usable state */
+inline void seedRng (Rng &rng, uint64_t seed)
+{
+  for(int k=0; k<4; k++)
+  {
+    seed += 0x9e3779b97f4a7c15ULL;
+    uint64_t z = seed;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    rng.s[k] = z ^ (z >> 31);
+  }
+}
+
+inline uint64_t nextRng (Rng &rng)
+{
+  uint64_t *s = rng.s;
+  uint64_t x = s[1] * 5;
+  uint64_t result = ((x << 7) | (x >> 57)) * 9;
+  uint64_t t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = (s[3] << 45) | (s[3] >> 19);
+  return result;
+}
+
+/* Uniform in [0, n), by multiplying rather than %, which is both faster
+ * and less biased */
+inline int rngBelow (Rng &rng, int n)
+{
+  return (int)(((nextRng(rng) >> 32) * (uint64_t)n) >> 32);
+}
+
+#endif
@@ -0,0 +1,374 @@
+/* Headless server: runs many matches played by bots, and streams each
+ * spectator the match it asked for as delta snapshots (spectate.h) over
+ * TCP. Spectators connect with sample2D --watch; a slow one gets fewer,
+ * larger deltas instead of holding the matches up.
+ * Build with "make server" and run ./server [options]
+ *   --matches N   matches to run (default 64)
+ *   --port N      port spectators connect to (default 7100)
+ *   --threads N   job threads, 0 for one per core (default)
+ *   --seed N      seed of the first match, the others follow (default 1)
+ *   --ticks N     stop after N ticks (default: run until killed)
+ *   --every N     ticks between snapshots (default 1)
+ *   --report N    ticks between metrics lines (default 300, 5 s)
+ *   --fast        run the ticks back to back instead of at 60 a second */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "world.h"
+#include "spectate.h"
+#include "jobs.h"
+
+using namespace std;
+
+#define TICK_MS (1000.0/60)
+
+struct Match {
+  World world;
+  Rng bot;
+  InputFrame input;
+  MatchView view;
+  bool watched;                    // views are only captured for a spectator
+  int games;
+};
+
+struct Client {
+  int sock;
+  int match;                       // -1 until the client says which
+  unsigned char hello[4];
+  int hello_got;
+  MatchView base;                  // the view the client has
+  vector<unsigned char> outbox;    // the message being sent
+  size_t sent;
+  bool full;                       // outbox carries the whole match
+  bool gone;
+};
+
+struct Server {
+  vector<Match> matches;
+  vector<Client*> clients;
+  int tick;
+
+  // Metrics since the last report
+  double step_ms, capture_ms, encode_ms;
+  long long bytes, deltas, delta_bytes, fulls, full_bytes, skipped;
+};
+
+static double now_ms ()
+{
+  return chrono::duration<double, milli>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* The bots fire all the time and every few ticks press something else */
+static void botInput (Match &match)
+{
+  unsigned game_keys = ((1u << INPUT_ACTIONS) - 1) &
+                       ~(1u << INPUT_ZOOM_IN | 1u << INPUT_ZOOM_OUT | 1u << INPUT_PAN_LEFT | 1u << INPUT_PAN_RIGHT);
+  if(rngBelow(match.bot, 8) == 0)
+    match.input.held = nextRng(match.bot) & game_keys;
+  match.input.held |= 1u << INPUT_FIRE;
+  match.input.stepped = rngBelow(match.bot, 4) == 0 ? nextRng(match.bot) & game_keys : 0;
+}
+
+static void stepMatches (int first, int last, int chunk, void *ctx)
+{
+  Server &server = *(Server*)ctx;
+  for(int m=first; m<last; m++)
+  {
+    Match &match = server.matches[m];
+    // A game over is shown for a tick before the next game starts
+    if(match.world.over)
+    {
+      resetWorld(match.world, nextRng(match.world.rng));
+      match.games++;
+    }
+    botInput(match);
+    stepWorld(match.world, match.input);
+  }
+}
+
+static void captureMatches (int first, int last, int chunk, void *ctx)
+{
+  Server &server = *(Server*)ctx;
+  for(int m=first; m<last; m++)
+  {
+    Match &match = server.matches[m];
+    if(match.watched)
+      captureView(match.world, server.tick, match.view);
+  }
+}
+
+/* A new message for every client that took all of its last one; the
+ * others are skipped this time and catch up with the next */
+static void encodeClients (int first, int last, int chunk, void *ctx)
+{
+  Server &server = *(Server*)ctx;
+  for(int c=first; c<last; c++)
+  {
+    Client &client = *server.clients[c];
+    if(client.match < 0 || client.gone || client.sent < client.outbox.size())
+      continue;
+    const MatchView &view = server.matches[client.match].view;
+    client.full = client.base.tick == 0;  // ticks count from 1
+    client.outbox.clear();
+    client.sent = 0;
+    encodeDelta(client.base, view, client.outbox);
+    client.base = view;
+  }
+}
+
+static int listenOn (int port)
+{
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  if(sock < 0)
+    return -1;
+  int yes = 1;
+  setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+  struct sockaddr_in local;
+  memset(&local, 0, sizeof(local));
+  local.sin_family = AF_INET;
+  local.sin_addr.s_addr = htonl(INADDR_ANY);
+  local.sin_port = htons(port);
+  if(bind(sock, (struct sockaddr*)&local, sizeof(local)) < 0 || listen(sock, 64) < 0 ||
+     fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK) < 0)
+  {
+    close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+static void acceptClients (Server &server, int listener)
+{
+  for(;;)
+  {
+    int sock = accept(listener, NULL, NULL);
+    if(sock < 0)
+      return;
+    int yes = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+    Client *client = new Client;
+    client->sock = sock;
+    client->match = -1;
+    client->hello_got = 0;
+    clearView(client->base);
+    client->sent = 0;
+    client->full = false;
+    client->gone = false;
+    server.clients.push_back(client);
+  }
+}
+
+/* Read which match each new client wants; after that, only look for
+ * clients hanging up */
+static void readClients (Server &server)
+{
+  for(int c=0; c<(int)server.clients.size(); c++)
+  {
+    Client &client = *server.clients[c];
+    unsigned char byte;
+    if(client.match >= 0)
+    {
+      int got = recv(client.sock, &byte, 1, 0);
+      if(got == 0 || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+        client.gone = true;
+      continue;
+    }
+    int got = recv(client.sock, client.hello + client.hello_got, 4 - client.hello_got, 0);
+    if(got == 0 || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+    {
+      client.gone = true;
+      continue;
+    }
+    if(got > 0)
+      client.hello_got += got;
+    if(client.hello_got == 4)
+    {
+      unsigned match = client.hello[0] | client.hello[1] << 8 | client.hello[2] << 16 | (unsigned)client.hello[3] << 24;
+      if(match >= server.matches.size())
+      {
+        fprintf(stderr, "a spectator asked for match %u of %d\n", match, (int)server.matches.size());
+        client.gone = true;
+        continue;
+      }
+      client.match = match;
+    }
+  }
+}
+
+/* Send what each socket takes without blocking */
+static void sendClients (Server &server)
+{
+  for(int c=0; c<(int)server.clients.size(); c++)
+  {
+    Client &client = *server.clients[c];
+    if(client.gone || client.sent >= client.outbox.size())
+      continue;
+    bool fresh = client.sent == 0;
+    int sent = send(client.sock, &client.outbox[client.sent], client.outbox.size() - client.sent, 0);
+    if(sent < 0)
+    {
+      if(errno != EAGAIN && errno != EWOULDBLOCK)
+        client.gone = true;
+      continue;
+    }
+    if(fresh)
+    {
+      if(client.full)
+      {
+        server.fulls++;
+        server.full_bytes += client.outbox.size();
+      }
+      else
+      {
+        server.deltas++;
+        server.delta_bytes += client.outbox.size();
+      }
+    }
+    client.sent += sent;
+    server.bytes += sent;
+  }
+
+  // Drop the clients that went away
+  int kept = 0;
+  for(int c=0; c<(int)server.clients.size(); c++)
+  {
+    Client *client = server.clients[c];
+    if(client->gone)
+    {
+      close(client->sock);
+      delete client;
+    }
+    else
+      server.clients[kept++] = client;
+  }
+  server.clients.resize(kept);
+}
+
+static void report (Server &server, int ticks, double elapsed_ms)
+{
+  int watching = 0, games = 0;
+  for(int c=0; c<(int)server.clients.size(); c++)
+    watching += server.clients[c]->match >= 0;
+  for(int m=0; m<(int)server.matches.size(); m++)
+    games += server.matches[m].games;
+  printf("tick %d: %d matches (%d games over), %d spectators | step %.3f ms, capture %.3f ms, encode %.3f ms per tick"
+         " | %.1f KB/s out, delta %.0f B, full %.0f B, %lld skipped\n",
+         server.tick, (int)server.matches.size(), games, watching, server.step_ms / ticks, server.capture_ms / ticks,
+         server.encode_ms / ticks, server.bytes / elapsed_ms, server.deltas ? (double)server.delta_bytes / server.deltas : 0.0,
+         server.fulls ? (double)server.full_bytes / server.fulls : 0.0, server.skipped);
+  fflush(stdout);
+  server.step_ms = server.capture_ms = server.encode_ms = 0;
+  server.bytes = server.deltas = server.delta_bytes = server.fulls = server.full_bytes = server.skipped = 0;
+}
+
+int main (int argc, char **argv)
+{
+  int matches = 64, port = 7100, threads = 0, ticks = 0, every = 1, report_every = 300;
+  uint64_t seed = 1;
+  bool fast = false;
+  for(int i=1; i<argc; i++)
+  {
+    if(strcmp(argv[i], "--matches") == 0 && i+1 < argc)
+      matches = atoi(argv[++i]);
+    else if(strcmp(argv[i], "--port") == 0 && i+1 < argc)
+      port = atoi(argv[++i]);
+    else if(strcmp(argv[i], "--threads") == 0 && i+1 < argc)
+      threads = atoi(argv[++i]);
+    else if(strcmp(argv[i], "--seed") == 0 && i+1 < argc)
+      seed = strtoull(argv[++i], NULL, 10);
+    else if(strcmp(argv[i], "--ticks") == 0 && i+1 < argc)
+      ticks = atoi(argv[++i]);
+    else if(strcmp(argv[i], "--every") == 0 && i+1 < argc)
+      every = max(atoi(argv[++i]), 1);
+    else if(strcmp(argv[i], "--report") == 0 && i+1 < argc)
+      report_every = max(atoi(argv[++i]), 1);
+    else if(strcmp(argv[i], "--fast") == 0)
+      fast = true;
+  }
+  signal(SIGPIPE, SIG_IGN);  // a spectator hanging up shows as a failed send
+  int listener = listenOn(port);
+  if(listener < 0)
+  {
+    fprintf(stderr, "can't listen on port %d\n", port);
+    return 1;
+  }
+  startJobs(threads);
+
+  Server server;
+  server.matches.resize(matches);
+  for(int m=0; m<matches; m++)
+  {
+    Match &match = server.matches[m];
+    match.world.parallel = false;  // the matches already run in parallel
+    resetWorld(match.world, seed + m);
+    seedRng(match.bot, seed + m);
+    match.input.held = match.input.stepped = 0;
+    clearView(match.view);
+    match.watched = false;
+    match.games = 0;
+  }
+  server.step_ms = server.capture_ms = server.encode_ms = 0;
+  server.bytes = server.deltas = server.delta_bytes = server.fulls = server.full_bytes = server.skipped = 0;
+  printf("serving %d matches on port %d\n", matches, port);
+  fflush(stdout);
+
+  double start = now_ms(), report_start = start;
+  for(server.tick=1; ticks == 0 || server.tick <= ticks; server.tick++)
+  {
+    acceptClients(server, listener);
+    readClients(server);
+
+    double t0 = now_ms();
+    parallelFor(matches, 1, stepMatches, &server);
+    double t1 = now_ms();
+    server.step_ms += t1 - t0;
+    if(server.tick % every == 0)
+    {
+      for(int m=0; m<matches; m++)
+        server.matches[m].watched = false;
+      for(int c=0; c<(int)server.clients.size(); c++)
+      {
+        const Client &client = *server.clients[c];
+        if(client.match >= 0)
+          server.matches[client.match].watched = true;
+        server.skipped += client.match >= 0 && client.sent < client.outbox.size();
+      }
+      parallelFor(matches, 1, captureMatches, &server);
+      double t2 = now_ms();
+      parallelFor(server.clients.size(), 1, encodeClients, &server);
+      server.capture_ms += t2 - t1;
+      server.encode_ms += now_ms() - t2;
+    }
+    sendClients(server);
+
+    if(server.tick % report_every == 0)
+    {
+      double at = now_ms();
+      report(server, report_every, at - report_start);
+      report_start = at;
+    }
+    if(!fast)
+      this_thread::sleep_for(chrono::duration<double, milli>(start + server.tick*TICK_MS - now_ms()));
+  }
+  for(int c=0; c<(int)server.clients.size(); c++)
+  {
+    close(server.clients[c]->sock);
+    delete server.clients[c];
+  }
+  close(listener);
+  return 0;
+}
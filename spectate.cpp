@@ -0,0 +1,407 @@
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "spectate.h"
+
+using namespace std;
+
+/* Scalars of a view, in the order of the bits saying which changed */
+enum ViewScalar {
+  VIEW_SCORE, VIEW_LIFE, VIEW_OVER, VIEW_Q1, VIEW_Q2, VIEW_Q3, VIEW_ANGLE,
+  VIEW_MIRROR, VIEW_FALLEN = VIEW_MIRROR + 4, VIEW_SCALARS
+};
+
+// Most bricks or lasers a message may make room for
+#define VIEW_MAX (1 << 24)
+
+// Which fields of a brick or laser follow its index
+#define BRICK_X 1
+#define BRICK_H 2
+#define BRICK_LOOK 4
+#define LAZER_X 1
+#define LAZER_Y 2
+#define LAZER_HEADING 4
+#define LAZER_ALIVE 8
+
+static void putVarint (vector<unsigned char> &out, unsigned value)
+{
+  while(value >= 0x80)
+  {
+    out.push_back((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  out.push_back(value);
+}
+
+/* Small differences either way in few bytes */
+static void putDiff (vector<unsigned char> &out, int now, int base)
+{
+  int diff = (int)((unsigned)now - (unsigned)base);
+  putVarint(out, ((unsigned)diff << 1) ^ (unsigned)(diff >> 31));
+}
+
+struct Reader {
+  const unsigned char *data;
+  int size, pos;
+  bool ok;
+};
+
+static unsigned getVarint (Reader &in)
+{
+  unsigned value = 0;
+  for(int shift=0; shift<35; shift+=7)
+  {
+    if(in.pos >= in.size)
+      break;
+    unsigned char byte = in.data[in.pos++];
+    value |= (unsigned)(byte & 0x7f) << shift;
+    if(!(byte & 0x80))
+      return value;
+  }
+  in.ok = false;
+  return 0;
+}
+
+static int getDiff (Reader &in, int base)
+{
+  unsigned zigzag = getVarint(in);
+  int diff = (int)(zigzag >> 1) ^ -(int)(zigzag & 1);
+  return (int)((unsigned)base + (unsigned)diff);
+}
+
+static int quantize (double value, float unit)
+{
+  return (int)lround(value*unit);
+}
+
+static const int *scalar (const MatchView &view, int k)
+{
+  switch(k)
+  {
+    case VIEW_SCORE: return &view.score;
+    case VIEW_LIFE: return &view.life;
+    case VIEW_OVER: return &view.over;
+    case VIEW_Q1: return &view.q1;
+    case VIEW_Q2: return &view.q2;
+    case VIEW_Q3: return &view.q3;
+    case VIEW_ANGLE: return &view.angle;
+    case VIEW_FALLEN: return &view.fallen;
+  }
+  return &view.mirror_angle[k - VIEW_MIRROR];
+}
+
+static int *scalar (MatchView &view, int k)
+{
+  return const_cast<int*>(scalar((const MatchView&)view, k));
+}
+
+void clearView (MatchView &view)
+{
+  view.tick = 0;
+  for(int k=0; k<VIEW_SCALARS; k++)
+    *scalar(view, k) = 0;
+  view.bricks.clear();
+  view.lazers.clear();
+}
+
+void captureView (const World &world, int tick, MatchView &view)
+{
+  view.tick = tick;
+  view.score = world.score;
+  view.life = world.life;
+  view.over = world.over;
+  view.q1 = quantize(world.q1, VIEW_UNIT);
+  view.q2 = quantize(world.q2, VIEW_UNIT);
+  view.q3 = quantize(world.q3, VIEW_UNIT);
+  view.angle = quantize(world.angle, VIEW_DEGREE);
+  for(int k=0; k<4; k++)
+    view.mirror_angle[k] = k < (int)world.mirrors.size() ? quantize(world.mirrors[k].angle, VIEW_DEGREE) : 0;
+  view.fallen = quantize(world.fallen, VIEW_UNIT);
+
+  view.bricks.resize(world.n);
+  for(int i=0; i<world.n; i++)
+  {
+    ViewBrick &brick = view.bricks[i];
+    brick.x = quantize(world.x[i], VIEW_UNIT);
+    brick.h = quantize(world.y[i] + world.fallen, VIEW_UNIT);
+    brick.colour = (unsigned char)world.z[i];
+    brick.alive = world.e[i] == 1;
+  }
+  view.lazers.resize(world.n1);
+  for(int i=0; i<world.n1; i++)
+  {
+    ViewLazer &lazer = view.lazers[i];
+    if(world.p[i] != 1)
+    {
+      memset(&lazer, 0, sizeof(lazer));
+      continue;
+    }
+    float px, py, dx, dy;
+    int seg = world.beam_seg[i];
+    lazerPoint(world, i, world.r[i], seg, px, py, dx, dy);
+    lazer.x = quantize(px, VIEW_UNIT);
+    lazer.y = quantize(py, VIEW_UNIT);
+    lazer.heading = quantize(atan2(dy, dx)*180/M_PI, VIEW_DEGREE);
+    lazer.alive = 1;
+  }
+}
+
+void encodeDelta (const MatchView &base, const MatchView &now, vector<unsigned char> &out)
+{
+  size_t start = out.size();
+  out.resize(start + 4);
+  putVarint(out, now.tick);
+
+  unsigned changed = 0;
+  for(int k=0; k<VIEW_SCALARS; k++)
+    changed |= (unsigned)(*scalar(now, k) != *scalar(base, k)) << k;
+  putVarint(out, changed);
+  for(int k=0; k<VIEW_SCALARS; k++)
+    if(changed >> k & 1)
+      putDiff(out, *scalar(now, k), *scalar(base, k));
+
+  // Bricks: how many there are now, then the ones that changed, each by its
+  // distance from the last one sent
+  static const ViewBrick no_brick = { 0, 0, 0, 0 };
+  int n = now.bricks.size(), base_n = base.bricks.size();
+  putVarint(out, n);
+  size_t count_at = out.size();
+  int count = 0, last = -1;
+  out.resize(count_at + 5);  // room for the count, filled in below
+  for(int i=0; i<n; i++)
+  {
+    const ViewBrick &was = i < base_n ? base.bricks[i] : no_brick, &is = now.bricks[i];
+    unsigned fields = (is.x != was.x ? BRICK_X : 0) | (is.h != was.h ? BRICK_H : 0) |
+                      (is.colour != was.colour || is.alive != was.alive ? BRICK_LOOK : 0);
+    if(i < base_n && !fields)
+      continue;
+    putVarint(out, i - last - 1);
+    out.push_back(fields);
+    if(fields & BRICK_X)
+      putDiff(out, is.x, was.x);
+    if(fields & BRICK_H)
+      putDiff(out, is.h, was.h);
+    if(fields & BRICK_LOOK)
+      out.push_back(is.colour | is.alive << 2);
+    last = i;
+    count++;
+  }
+  // The count goes in a fixed five byte varint, so nothing has to move
+  for(int k=0; k<5; k++)
+    out[count_at + k] = ((unsigned)count >> (7*k) & 0x7f) | (k < 4 ? 0x80 : 0);
+
+  static const ViewLazer no_lazer = { 0, 0, 0, 0 };
+  n = now.lazers.size();
+  base_n = base.lazers.size();
+  putVarint(out, n);
+  count_at = out.size();
+  count = 0;
+  last = -1;
+  out.resize(count_at + 5);
+  for(int i=0; i<n; i++)
+  {
+    const ViewLazer &was = i < base_n ? base.lazers[i] : no_lazer, &is = now.lazers[i];
+    unsigned fields = (is.x != was.x ? LAZER_X : 0) | (is.y != was.y ? LAZER_Y : 0) |
+                      (is.heading != was.heading ? LAZER_HEADING : 0) | (is.alive != was.alive ? LAZER_ALIVE : 0);
+    if(i < base_n && !fields)
+      continue;
+    putVarint(out, i - last - 1);
+    out.push_back(fields);
+    if(fields & LAZER_X)
+      putDiff(out, is.x, was.x);
+    if(fields & LAZER_Y)
+      putDiff(out, is.y, was.y);
+    if(fields & LAZER_HEADING)
+      putDiff(out, is.heading, was.heading);
+    last = i;
+    count++;
+  }
+  for(int k=0; k<5; k++)
+    out[count_at + k] = ((unsigned)count >> (7*k) & 0x7f) | (k < 4 ? 0x80 : 0);
+
+  unsigned length = out.size() - start - 4;
+  for(int k=0; k<4; k++)
+    out[start + k] = (unsigned char)(length >> (8*k));
+}
+
+bool applyDelta (MatchView &view, const unsigned char *data, int size)
+{
+  Reader in = { data, size, 0, true };
+  view.tick = getVarint(in);
+  unsigned changed = getVarint(in);
+  for(int k=0; k<VIEW_SCALARS; k++)
+    if(changed >> k & 1)
+      *scalar(view, k) = getDiff(in, *scalar(view, k));
+
+  int n = getVarint(in), count = getVarint(in), i = -1;
+  if(!in.ok || n < 0 || n > VIEW_MAX)
+    return false;
+  ViewBrick no_brick = { 0, 0, 0, 0 };
+  view.bricks.resize(n, no_brick);
+  for(int k=0; k<count && in.ok; k++)
+  {
+    i += getVarint(in) + 1;
+    if(i >= n || in.pos >= size)
+      return false;
+    ViewBrick &brick = view.bricks[i];
+    unsigned fields = in.data[in.pos++];
+    if(fields & BRICK_X)
+      brick.x = getDiff(in, brick.x);
+    if(fields & BRICK_H)
+      brick.h = getDiff(in, brick.h);
+    if(fields & BRICK_LOOK)
+    {
+      if(in.pos >= size)
+        return false;
+      unsigned char look = in.data[in.pos++];
+      brick.colour = look & 3;
+      brick.alive = look >> 2 & 1;
+    }
+  }
+
+  n = getVarint(in);
+  count = getVarint(in);
+  i = -1;
+  if(!in.ok || n < 0 || n > VIEW_MAX)
+    return false;
+  ViewLazer no_lazer = { 0, 0, 0, 0 };
+  view.lazers.resize(n, no_lazer);
+  for(int k=0; k<count && in.ok; k++)
+  {
+    i += getVarint(in) + 1;
+    if(i >= n || in.pos >= size)
+      return false;
+    ViewLazer &lazer = view.lazers[i];
+    unsigned fields = in.data[in.pos++];
+    if(fields & LAZER_X)
+      lazer.x = getDiff(in, lazer.x);
+    if(fields & LAZER_Y)
+      lazer.y = getDiff(in, lazer.y);
+    if(fields & LAZER_HEADING)
+      lazer.heading = getDiff(in, lazer.heading);
+    if(fields & LAZER_ALIVE)
+      lazer.alive = !lazer.alive;
+  }
+  return in.ok && in.pos == size;
+}
+
+void showView (const MatchView &view, World &world)
+{
+  world.score = view.score;
+  world.life = view.life;
+  world.over = view.over;
+  world.q1 = view.q1 / VIEW_UNIT;
+  world.q2 = view.q2 / VIEW_UNIT;
+  world.q3 = view.q3 / VIEW_UNIT;
+  world.angle = view.angle / VIEW_DEGREE;
+  for(int k=0; k<4 && k<(int)world.mirrors.size(); k++)
+  {
+    world.mirrors[k].angle = view.mirror_angle[k] / VIEW_DEGREE;
+    placeMirror(world.mirrors[k]);
+  }
+  world.fall_step = 0;
+
+  int n = view.bricks.size();
+  world.n = n;
+  world.x.resize(n);
+  world.y.resize(n);
+  world.z.resize(n);
+  world.e.resize(n);
+  for(int i=0; i<n; i++)
+  {
+    const ViewBrick &brick = view.bricks[i];
+    world.x[i] = brick.x / VIEW_UNIT;
+    world.y[i] = (brick.h - view.fallen) / VIEW_UNIT;
+    world.z[i] = brick.colour;
+    world.e[i] = brick.alive;
+  }
+
+  int n1 = view.lazers.size();
+  showLazers(world, n1);
+  for(int i=0; i<n1; i++)
+  {
+    const ViewLazer &lazer = view.lazers[i];
+    placeLazer(world, i, lazer.x / VIEW_UNIT, lazer.y / VIEW_UNIT, lazer.heading / VIEW_DEGREE * M_PI/180, lazer.alive);
+  }
+}
+
+bool watchMatch (Spectator &spectator, const char *host, int port, int match)
+{
+  spectator.inbox.clear();
+  spectator.messages = 0;
+  spectator.bytes = 0;
+  clearView(spectator.view);
+
+  char service[16];
+  snprintf(service, sizeof(service), "%d", port);
+  struct addrinfo hints, *found;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  if(getaddrinfo(host, service, &hints, &found) != 0)
+    return false;
+  spectator.sock = socket(AF_INET, SOCK_STREAM, 0);
+  bool ok = spectator.sock >= 0 && connect(spectator.sock, found->ai_addr, found->ai_addrlen) == 0;
+  freeaddrinfo(found);
+  unsigned char hello[4];
+  for(int k=0; k<4; k++)
+    hello[k] = (unsigned char)((unsigned)match >> (8*k));
+  if(!ok || send(spectator.sock, hello, 4, 0) != 4 ||
+     fcntl(spectator.sock, F_SETFL, fcntl(spectator.sock, F_GETFL) | O_NONBLOCK) < 0)
+  {
+    if(spectator.sock >= 0)
+      close(spectator.sock);
+    spectator.sock = -1;
+    return false;
+  }
+  return true;
+}
+
+bool receiveViews (Spectator &spectator)
+{
+  if(spectator.sock < 0)
+    return false;
+  vector<unsigned char> &inbox = spectator.inbox;
+  for(;;)
+  {
+    size_t size = inbox.size();
+    inbox.resize(size + 65536);
+    int got = recv(spectator.sock, &inbox[size], 65536, 0);
+    inbox.resize(size + (got > 0 ? got : 0));
+    if(got > 0)
+    {
+      spectator.bytes += got;
+      continue;
+    }
+    if(got == 0)
+    {
+      close(spectator.sock);
+      spectator.sock = -1;
+    }
+    break;
+  }
+
+  size_t pos = 0;
+  while(inbox.size() - pos >= 4)
+  {
+    unsigned length = inbox[pos] | inbox[pos+1] << 8 | inbox[pos+2] << 16 | (unsigned)inbox[pos+3] << 24;
+    if(inbox.size() - pos - 4 < length)
+      break;
+    if(!applyDelta(spectator.view, &inbox[pos + 4], length))
+    {
+      close(spectator.sock);
+      spectator.sock = -1;
+      return false;
+    }
+    spectator.messages++;
+    pos += 4 + length;
+  }
+  inbox.erase(inbox.begin(), inbox.begin() + pos);
+  return spectator.sock >= 0;
+}
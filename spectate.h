@@ -0,0 +1,65 @@
+#ifndef SPECTATE_H
+#define SPECTATE_H
+
+#include <vector>
+#include "world.h"
+
+/* What a spectator sees of a match, quantized, and the messages that bring
+ * one spectator's copy up to the server's: only what changed since the
+ * last message, as small varint differences. Bricks are kept as their
+ * height above the line every brick falls with, so a falling brick costs
+ * nothing after it first appears; the line goes once per message. */
+
+#define VIEW_UNIT 256.0f    // positions in 1/256 of a world unit
+#define VIEW_DEGREE 16.0f   // angles in 1/16 of a degree
+
+struct ViewBrick {
+  int x, h;                 // h: height above the fall line
+  unsigned char colour, alive;
+};
+
+struct ViewLazer {
+  int x, y, heading;        // tip and direction
+  unsigned char alive;
+};
+
+struct MatchView {
+  int tick;
+  int score, life, over;
+  int q1, q2, q3, angle;
+  int mirror_angle[4];
+  int fallen;               // the fall line
+  std::vector<ViewBrick> bricks;
+  std::vector<ViewLazer> lazers;
+};
+
+/* Nothing yet: the first message against it carries the whole match */
+void clearView (MatchView &view);
+
+void captureView (const World &world, int tick, MatchView &view);
+
+/* Append a message taking base to now, its length first */
+void encodeDelta (const MatchView &base, const MatchView &now, std::vector<unsigned char> &out);
+
+/* Apply a message without its length; false if it is malformed */
+bool applyDelta (MatchView &view, const unsigned char *data, int size);
+
+/* Set up world to be drawn as the view; nothing in it is simulated */
+void showView (const MatchView &view, World &world);
+
+/* A connection to a server, watching one match */
+struct Spectator {
+  int sock;
+  std::vector<unsigned char> inbox;   // bytes of a message not all here yet
+  MatchView view;
+  int messages;
+  long long bytes;
+};
+
+/* Connect to host:port and ask for match; false if the server isn't there */
+bool watchMatch (Spectator &spectator, const char *host, int port, int match);
+
+/* Apply every whole message waiting; false once the server is gone */
+bool receiveViews (Spectator &spectator);
+
+#endif
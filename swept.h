@@ -0,0 +1,49 @@
+#ifndef SWEPT_H
+#define SWEPT_H
+
+/* Continuous collision tests, so fast movers can't tunnel between frames */
+
+/* Entry time in [0, 1] of the segment (x0,y0)->(x1,y1) into the box
+ * [min_x, max_x] x [min_y, max_y] (slab test). Returns false on a miss; a
+ * segment starting inside the box enters at t = 0. */
+inline bool segmentEntersBox (float x0, float y0, float x1, float y1,
+                              float min_x, float min_y, float max_x, float max_y, float &t)
+{
+  float t_in = 0, t_out = 1;
+  float d[2] = { x1 - x0, y1 - y0 };
+  float o[2] = { x0, y0 };
+  float lo[2] = { min_x, min_y };
+  float hi[2] = { max_x, max_y };
+  for(int a=0; a<2; a++)
+  {
+    if(d[a] == 0)
+    {
+      if(o[a] < lo[a] || o[a] > hi[a])
+        return false;
+      continue;
+    }
+    float t0 = (lo[a] - o[a]) / d[a];
+    float t1 = (hi[a] - o[a]) / d[a];
+    if(t0 > t1)
+    {
+      float tmp = t0;
+      t0 = t1;
+      t1 = tmp;
+    }
+    if(t0 > t_in) t_in = t0;
+    if(t1 < t_out) t_out = t1;
+    if(t_in > t_out)
+      return false;
+  }
+  t = t_in;
+  return true;
+}
+
+/* Did something that moved down from y_from to y_to this step pass through
+ * the band [lo, hi]? */
+inline bool sweptThroughBand (float y_from, float y_to, float lo, float hi)
+{
+  return y_to <= hi && y_from >= lo;
+}
+
+#endif
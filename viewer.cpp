@@ -0,0 +1,121 @@
+/* Read only viewer of a game published with sample2D --broadcast: maps the
+ * shared memory feed (broadcast.h) and draws each new frame in the
+ * terminal. Any number can run at once; the game doesn't know about them.
+ * Build with "make viewer" and run ./viewer [options]
+ *   --feed NAME   the feed to map (default /brickbreaker)
+ *   --fps N       frames drawn per second at most (default 30)
+ *   --quiet       only count the frames, draw nothing */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "world.h"
+#include "broadcast.h"
+
+using namespace std;
+
+#define COLUMNS 64
+#define ROWS 32
+#define ARENA 4.0f      // the window shows -4..4 both ways
+#define IDLE_SECONDS 5  // stop after this long without a frame
+
+static FeedFrame latest;  // too big for the stack
+
+static void plot (char grid[ROWS][COLUMNS+1], float x, float y, char c)
+{
+  int col = (int)((x + ARENA) / (2*ARENA) * COLUMNS), row = (int)((ARENA - y) / (2*ARENA) * ROWS);
+  if(col >= 0 && col < COLUMNS && row >= 0 && row < ROWS)
+    grid[row][col] = c;
+}
+
+static void drawWorld (const World &world, const FeedFrame &frame, long long missed, int retries)
+{
+  char grid[ROWS][COLUMNS+1];
+  for(int row=0; row<ROWS; row++)
+  {
+    memset(grid[row], ' ', COLUMNS);
+    grid[row][COLUMNS] = 0;
+  }
+  for(int k=0; k<(int)world.mirrors.size(); k++)
+  {
+    const Mirror &m = world.mirrors[k];
+    for(int s=0; s<=8; s++)
+      plot(grid, m.x0 + (m.x1 - m.x0)*s/8, m.y0 + (m.y1 - m.y0)*s/8, '/');
+  }
+  static const char brick_look[3] = { 'r', 'g', '#' };
+  for(int i=0; i<world.n; i++)
+    plot(grid, world.x[i], world.y[i], brick_look[(int)world.z[i] % 3]);
+  for(int i=0; i<world.n1; i++)
+  {
+    int seg = 0;
+    float px, py, dx, dy;
+    lazerPoint(world, i, world.r[i], seg, px, py, dx, dy);
+    plot(grid, px, py, '-');
+  }
+  plot(grid, -3.75f, world.q3, '>');
+  plot(grid, -2 + world.q1, -3.4f, 'R');
+  plot(grid, 2 + world.q2, -3.4f, 'G');
+
+  printf("\033[H");  // over the last frame
+  for(int row=0; row<ROWS; row++)
+    printf("|%s|\n", grid[row]);
+  printf("tick %d  score %d  life %d%s  | frame %u, %lld missed, %d retries\033[K\n", frame.tick, frame.score,
+         frame.life, frame.over ? "  GAME OVER" : "", frame.frame, missed, retries);
+  fflush(stdout);
+}
+
+int main (int argc, char **argv)
+{
+  const char *name = "/brickbreaker";
+  int fps = 30;
+  bool quiet = false;
+  for(int i=1; i<argc; i++)
+  {
+    if(strcmp(argv[i], "--feed") == 0 && i+1 < argc)
+      name = argv[++i];
+    else if(strcmp(argv[i], "--fps") == 0 && i+1 < argc)
+      fps = max(atoi(argv[++i]), 1);
+    else if(strcmp(argv[i], "--quiet") == 0)
+      quiet = true;
+  }
+  const Feed *feed = openFeed(name);
+  if(!feed)
+  {
+    fprintf(stderr, "no feed %s; start sample2D --broadcast %s first\n", name, name);
+    return 1;
+  }
+
+  World world;
+  uint32_t seen = 0;
+  long long shown = 0, missed = 0;
+  int retries = 0;
+  uint32_t last_frame = 0;
+  auto idle_since = chrono::steady_clock::now();
+  if(!quiet)
+    printf("\033[2J");
+  for(;;)
+  {
+    if(readFrame(feed, seen, latest, retries))
+    {
+      if(shown > 0)
+        missed += latest.frame - last_frame - 1;
+      last_frame = latest.frame;
+      shown++;
+      idle_since = chrono::steady_clock::now();
+      if(!quiet)
+      {
+        showFrame(latest, world);
+        drawWorld(world, latest, missed, retries);
+      }
+    }
+    else if(chrono::steady_clock::now() - idle_since > chrono::seconds(IDLE_SECONDS))
+      break;
+    this_thread::sleep_for(chrono::microseconds(1000000 / fps));
+  }
+  printf("\nno frame for %d s: %lld frames shown, %lld missed, %d retries\n", IDLE_SECONDS, shown, missed, retries);
+  closeFeed(feed);
+  return 0;
+}
@@ -0,0 +1,758 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "world.h"
+#include "aabb_simd.h"
+#include "swept.h"
+#include "beam.h"
+#include "jobs.h"
+#include "controls.h"
+
+using namespace std;
+
+// Bricks are queued a little early so float drift in y can't skip a catch
+#define CATCH_MARGIN 0.01
+
+/* Items per job; small enough to spread a few thousand bricks over the
+ * workers, big enough that a job is worth queueing */
+#define BRICK_GRAIN 4096
+#define LAZER_GRAIN 64
+#define CATCH_GRAIN 1024
+
+/* The level's mirrors: centre, half length and angle before any rotation */
+static const float level_mirrors[][4] = {
+  { 3, -2, 0.4036, 48.01 },
+  { 0, 0, 0.4036, 48.01 },
+  { 3, 3, 0.4036, 131.99 },
+  { 0, 3, 0.4036, 131.99 }
+};
+
+World::World () : collision_backend(COLLIDE_GRID), parallel(true)
+{
+  resetWorld(*this, 0);
+}
+
+void resetWorld (World &world, uint64_t seed)
+{
+  seedRng(world.rng, seed);
+  world.n = 0;
+  world.x.clear();
+  world.y.clear();
+  world.z.clear();
+  world.e.clear();
+  world.n1 = 0;
+  world.r.clear();
+  world.p.clear();
+  world.ct = 0;
+  world.delay = 0;
+  world.life = 5;
+  world.score = 0;
+  world.over = false;
+  world.q1 = world.q2 = world.q3 = world.angle = 0;
+  world.fall_step = 0;
+  world.fallen = 0;
+  world.catch_queue.heap.clear();
+  world.catch_queue.in_band.clear();
+  world.prev_x.clear();
+  world.prev_y.clear();
+  world.beam_x.clear();
+  world.beam_y.clear();
+  world.beam_len.clear();
+  world.beam_count.clear();
+  world.beam_seg.clear();
+  world.brick_sap.known_bricks = 0;
+  world.brick_sap.known_lazers = 0;
+  world.brick_sap.bricks.clear();
+  world.brick_sap.lazers.clear();
+  world.brick_sap.pairs.clear();
+  world.events.clear();
+
+  world.mirrors.clear();
+  for(int k=0; k<4; k++)
+  {
+    world.mirror_rotation[k] = 0;
+    world.mirrors.push_back(makeMirror(level_mirrors[k][0], level_mirrors[k][1], level_mirrors[k][2], level_mirrors[k][3]));
+  }
+  buildMirrorBVH(world.mirror_bvh, world.mirrors);
+}
+
+void reserveWorld (World &world, int bricks, int lazers)
+{
+  world.x.reserve(bricks);
+  world.y.reserve(bricks);
+  world.z.reserve(bricks);
+  world.e.reserve(bricks);
+  world.catch_queue.heap.reserve(bricks);
+  world.catch_queue.in_band.reserve(bricks);
+  world.catch_baskets.reserve(bricks);
+  world.candidates.reserve(bricks);
+  if((int)world.chunk_candidates.size() < jobChunks(lazers, LAZER_GRAIN))
+    world.chunk_candidates.resize(jobChunks(lazers, LAZER_GRAIN));
+  for(int c=0; c<(int)world.chunk_candidates.size(); c++)
+    world.chunk_candidates[c].reserve(bricks);
+  // The grid has at most about 4 cells per brick, see buildBrickGrid()
+  world.brick_grid.cell_start.reserve(8*bricks + 256);
+  world.brick_grid.cell_items.reserve(4*bricks);
+  world.brick_grid.brick_cells.reserve(4*bricks);
+  world.brick_sap.bricks.reserve(bricks);
+  world.brick_sap.lazers.reserve(lazers);
+  world.brick_sap.pairs.reserve(bricks + lazers);
+
+  world.r.reserve(lazers);
+  world.p.reserve(lazers);
+  world.tip_x.reserve(lazers);
+  world.tip_y.reserve(lazers);
+  world.prev_x.reserve(lazers);
+  world.prev_y.reserve(lazers);
+  world.sweep_lo.reserve(lazers);
+  world.sweep_hi.reserve(lazers);
+  world.beam_x.reserve(lazers*BEAM_POINTS);
+  world.beam_y.reserve(lazers*BEAM_POINTS);
+  world.beam_len.reserve(lazers*BEAM_POINTS);
+  world.beam_count.reserve(lazers);
+  world.beam_seg.reserve(lazers);
+  world.lazer_best.reserve(lazers);
+  world.lazer_best_t.reserve(lazers);
+  world.sap_first.reserve(lazers+1);
+  world.chunk_best.reserve(jobChunks(bricks, BRICK_GRAIN)*lazers);
+  world.chunk_best_t.reserve(jobChunks(bricks, BRICK_GRAIN)*lazers);
+  // A tick reports a few events at most
+  world.events.reserve(64);
+}
+
+/* Fixed part of a snapshot */
+struct SnapshotHeader {
+  int n, n1, ct, delay, life, score, over;
+  float q1, q2, q3, angle, mirror_rotation[4];
+  float fall_step;
+  double fallen;
+  Rng rng;
+  int heap, in_band, mirrors;  // lengths of the variable columns
+  int known_bricks, known_lazers, sap_bricks, sap_lazers;
+};
+
+template <class T>
+static void saveColumn (unsigned char *&out, const vector<T> &column, int count)
+{
+  memcpy(out, column.data(), count*sizeof(T));
+  out += count*sizeof(T);
+}
+
+template <class T>
+static void restoreColumn (const unsigned char *&in, vector<T> &column, int count)
+{
+  column.resize(count);
+  memcpy(column.data(), in, count*sizeof(T));
+  in += count*sizeof(T);
+}
+
+void saveWorld (const World &world, WorldSnapshot &snapshot)
+{
+  SnapshotHeader head;
+  memset(&head, 0, sizeof(head));  // no stray padding bytes, so equal states give equal snapshots
+  head.n = world.n;
+  head.n1 = world.n1;
+  head.ct = world.ct;
+  head.delay = world.delay;
+  head.life = world.life;
+  head.score = world.score;
+  head.over = world.over;
+  head.q1 = world.q1;
+  head.q2 = world.q2;
+  head.q3 = world.q3;
+  head.angle = world.angle;
+  memcpy(head.mirror_rotation, world.mirror_rotation, sizeof(head.mirror_rotation));
+  head.fall_step = world.fall_step;
+  head.fallen = world.fallen;
+  head.rng = world.rng;
+  head.heap = world.catch_queue.heap.size();
+  head.in_band = world.catch_queue.in_band.size();
+  head.mirrors = world.mirrors.size();
+  head.known_bricks = world.brick_sap.known_bricks;
+  head.known_lazers = world.brick_sap.known_lazers;
+  head.sap_bricks = world.brick_sap.bricks.size();
+  head.sap_lazers = world.brick_sap.lazers.size();
+
+  int n = world.n, n1 = world.n1;
+  snapshot.data.resize(sizeof(head) + 4*n*sizeof(float) + 4*n1*sizeof(float) + 2*n1*sizeof(int)
+                       + 3*n1*BEAM_POINTS*sizeof(float) + head.heap*sizeof(CatchEvent)
+                       + head.in_band*sizeof(int) + head.mirrors*sizeof(Mirror)
+                       + (head.sap_bricks + head.sap_lazers)*sizeof(int));
+  unsigned char *out = snapshot.data.data();
+  memcpy(out, &head, sizeof(head));
+  out += sizeof(head);
+  saveColumn(out, world.x, n);
+  saveColumn(out, world.y, n);
+  saveColumn(out, world.z, n);
+  saveColumn(out, world.e, n);
+  saveColumn(out, world.r, n1);
+  saveColumn(out, world.p, n1);
+  saveColumn(out, world.prev_x, n1);
+  saveColumn(out, world.prev_y, n1);
+  saveColumn(out, world.beam_count, n1);
+  saveColumn(out, world.beam_seg, n1);
+  saveColumn(out, world.beam_x, n1*BEAM_POINTS);
+  saveColumn(out, world.beam_y, n1*BEAM_POINTS);
+  saveColumn(out, world.beam_len, n1*BEAM_POINTS);
+  saveColumn(out, world.catch_queue.heap, head.heap);
+  saveColumn(out, world.catch_queue.in_band, head.in_band);
+  saveColumn(out, world.mirrors, head.mirrors);
+  saveColumn(out, world.brick_sap.bricks, head.sap_bricks);
+  saveColumn(out, world.brick_sap.lazers, head.sap_lazers);
+}
+
+void restoreWorld (World &world, const WorldSnapshot &snapshot)
+{
+  SnapshotHeader head;
+  const unsigned char *in = snapshot.data.data();
+  memcpy(&head, in, sizeof(head));
+  in += sizeof(head);
+  world.n = head.n;
+  world.n1 = head.n1;
+  world.ct = head.ct;
+  world.delay = head.delay;
+  world.life = head.life;
+  world.score = head.score;
+  world.over = head.over;
+  world.q1 = head.q1;
+  world.q2 = head.q2;
+  world.q3 = head.q3;
+  world.angle = head.angle;
+  memcpy(world.mirror_rotation, head.mirror_rotation, sizeof(head.mirror_rotation));
+  world.fall_step = head.fall_step;
+  world.fallen = head.fallen;
+  world.rng = head.rng;
+
+  int n = head.n, n1 = head.n1;
+  restoreColumn(in, world.x, n);
+  restoreColumn(in, world.y, n);
+  restoreColumn(in, world.z, n);
+  restoreColumn(in, world.e, n);
+  restoreColumn(in, world.r, n1);
+  restoreColumn(in, world.p, n1);
+  restoreColumn(in, world.prev_x, n1);
+  restoreColumn(in, world.prev_y, n1);
+  restoreColumn(in, world.beam_count, n1);
+  restoreColumn(in, world.beam_seg, n1);
+  restoreColumn(in, world.beam_x, n1*BEAM_POINTS);
+  restoreColumn(in, world.beam_y, n1*BEAM_POINTS);
+  restoreColumn(in, world.beam_len, n1*BEAM_POINTS);
+  restoreColumn(in, world.catch_queue.heap, head.heap);
+  restoreColumn(in, world.catch_queue.in_band, head.in_band);
+  restoreColumn(in, world.mirrors, head.mirrors);
+  // The sweep and prune lists follow the bricks and lasers incrementally;
+  // rebuilding them would insertion sort every brick on each rollback
+  restoreColumn(in, world.brick_sap.bricks, head.sap_bricks);
+  restoreColumn(in, world.brick_sap.lazers, head.sap_lazers);
+  world.brick_sap.known_bricks = head.known_bricks;
+  world.brick_sap.known_lazers = head.known_lazers;
+
+  // The BVH follows the restored mirrors
+  world.events.clear();
+  refitMirrorBVH(world.mirror_bvh, world.mirrors);
+}
+
+/* parallelFor(), or the same chunks one after another on this thread */
+static void runJobs (World &world, int n, int grain, JobFn fn)
+{
+  if(world.parallel)
+  {
+    parallelFor(n, grain, fn, &world);
+    return;
+  }
+  for(int c=0; c<jobChunks(n, grain); c++)
+    fn(c*grain, min(n, (c+1)*grain), c, &world);
+}
+
+static void report (World &world, int type)
+{
+  WorldEvent event;
+  event.type = type;
+  event.score = world.score;
+  event.life = world.life;
+  world.events.push_back(event);
+  if(type == EVENT_LIVES_OVER || type == EVENT_BLACK_BRICK)
+  {
+    world.over = true;
+  }
+}
+
+/* When (0..1) laser i's sweep this tick enters brick w, or -1 for a miss.
+ * The sweep runs from last tick's tip to this tick's, taken relative to
+ * the brick, which fell fall_step in between. */
+static float lazerEntry (const World &world, int i, int w)
+{
+  float t;
+  if(world.e[w] == 1 && segmentEntersBox(world.prev_x[i], world.prev_y[i] - world.fall_step, world.tip_x[i], world.tip_y[i],
+                                          world.x[w]-0.125, world.y[w]-0.15, world.x[w]+0.125, world.y[w]+0.15, t))
+  {
+    return t;
+  }
+  return -1;
+}
+
+/* Keep the brick laser i reaches first; ties go to the lower index */
+static void closestHit (const World &world, int i, int w, int &best, float &best_t)
+{
+  float t = lazerEntry(world, i, w);
+  if(t >= 0 && t < best_t)
+  {
+    best = w;
+    best_t = t;
+  }
+}
+
+void lazerPoint (const World &world, int i, float dist, int &seg, float &px, float &py, float &dx, float &dy)
+{
+  int slot = i*BEAM_POINTS;
+  beamPoint(&world.beam_x[slot], &world.beam_y[slot], &world.beam_len[slot], world.beam_count[i], dist, seg, px, py, dx, dy);
+}
+
+void showLazers (World &world, int n1)
+{
+  world.n1 = n1;
+  world.r.assign(n1, 1);  // the tip is one unit along the beam
+  world.p.resize(n1);
+  world.beam_count.assign(n1, 2);
+  world.beam_seg.assign(n1, 0);
+  world.beam_x.resize(n1*BEAM_POINTS);
+  world.beam_y.resize(n1*BEAM_POINTS);
+  world.beam_len.resize(n1*BEAM_POINTS);
+}
+
+void placeLazer (World &world, int i, float x, float y, float heading, bool alive)
+{
+  float dx = cos(heading), dy = sin(heading);
+  int slot = i*BEAM_POINTS;
+  world.p[i] = alive;
+  world.beam_x[slot] = x - dx;
+  world.beam_y[slot] = y - dy;
+  world.beam_len[slot] = 0;
+  world.beam_x[slot+1] = x + dx;
+  world.beam_y[slot+1] = y + dy;
+  world.beam_len[slot+1] = 2;
+}
+
+void fireLazer (World &world, float py, float heading)
+{
+  int i = world.n1++;
+  world.r.push_back(0);
+  world.p.push_back(1);
+  world.prev_x.push_back(-3.45);
+  world.prev_y.push_back(py);
+  world.beam_x.resize(world.n1*BEAM_POINTS);
+  world.beam_y.resize(world.n1*BEAM_POINTS);
+  world.beam_len.resize(world.n1*BEAM_POINTS);
+  int slot = i*BEAM_POINTS;
+  world.beam_count.push_back(traceBeam(world.mirror_bvh, world.mirrors, -3.45, py, cos(heading*M_PI/180.0f), sin(heading*M_PI/180.0f), 0,
+                                       &world.beam_x[slot], &world.beam_y[slot], &world.beam_len[slot]));
+  world.beam_seg.push_back(0);
+}
+
+/* Re-trace the live beams from where their lasers are now, after a mirror moved */
+static void retraceLazers (World &world)
+{
+  for(int i=0; i<world.n1; i++)
+  {
+    if(world.p[i]==1)
+    {
+      float px, py, dx, dy;
+      int slot = i*BEAM_POINTS;
+      lazerPoint(world, i, world.r[i], world.beam_seg[i], px, py, dx, dy);
+      world.beam_count[i] = traceBeam(world.mirror_bvh, world.mirrors, px, py, dx, dy, world.r[i], &world.beam_x[slot], &world.beam_y[slot], &world.beam_len[slot]);
+      world.beam_seg[i] = 0;
+    }
+  }
+}
+
+/* Follow mirror_rotation; turning in place only needs a refit */
+static void turnMirrors (World &world)
+{
+  bool moved = false;
+  for(int k=0; k<4; k++)
+  {
+    float angle = level_mirrors[k][3] + world.mirror_rotation[k];
+    if(world.mirrors[k].angle != angle)
+    {
+      world.mirrors[k].angle = angle;
+      placeMirror(world.mirrors[k]);
+      moved = true;
+    }
+  }
+  if(moved)
+  {
+    refitMirrorBVH(world.mirror_bvh, world.mirrors);
+    retraceLazers(world);
+  }
+}
+
+/* Move laser i dist units along its beam; it is gone once it reaches the
+ * end, at the arena edge or the mirror that absorbed it */
+static void advanceLazer (World &world, int i, float dist)
+{
+  world.r[i]=world.r[i]+dist;
+  if(world.r[i] >= world.beam_len[i*BEAM_POINTS + world.beam_count[i]-1])
+  {
+    world.p[i]=0;
+  }
+}
+
+/* Laser i stops in brick w */
+static void hitBrick (World &world, int i, int w)
+{
+  world.e[w]=0;
+  world.p[i]=0;
+  report(world, EVENT_HIT);
+  if(world.z[w]==0)
+  {
+    world.life=world.life-1;
+  }
+  else if(world.z[w]==1)
+  {
+    world.life=world.life-1;
+  }
+  else if(world.z[w]==2)
+  {
+    world.score=world.score+1;
+  }
+  if(world.life==0)
+  {
+    report(world, EVENT_LIVES_OVER);
+  }
+  report(world, EVENT_SCORE);
+}
+
+/* Bricks [first, last) that laser i's sweep enters, eight per kernel call
+ * against the sweep's box and the tail one at a time */
+static void bruteHit (const World &world, int i, int first, int last, int &best, float &best_t)
+{
+  float y0 = world.prev_y[i] - world.fall_step;
+  float cx = (world.sweep_lo[i] + world.sweep_hi[i]) / 2, ex = (world.sweep_hi[i] - world.sweep_lo[i]) / 2;
+  float cy = (y0 + world.tip_y[i]) / 2, ey = fabs(world.tip_y[i] - y0) / 2;
+  int w=first;
+  for(; w+8<=last; w+=8)
+  {
+    for(unsigned mask = bricksNearBox8(&world.x[w], &world.y[w], &world.e[w], cx, cy, ex, ey); mask; mask &= mask-1)
+      closestHit(world, i, w + __builtin_ctz(mask), best, best_t);
+  }
+  for(; w<last;w++)
+    closestHit(world, i, w, best, best_t);
+}
+
+static void findHitsBrute (int first, int last, int chunk, void *ctx)
+{
+  World &world = *(World*)ctx;
+  for(int i=0; i<world.n1; i++)
+  {
+    int &best = world.chunk_best[chunk*world.n1 + i];
+    float &best_t = world.chunk_best_t[chunk*world.n1 + i];
+    best = -1;
+    best_t = 2;
+    if(world.p[i] == 1)
+    {
+      bruteHit(world, i, first, last, best, best_t);
+    }
+  }
+}
+
+static void findHitsGrid (int first, int last, int chunk, void *ctx)
+{
+  World &world = *(World*)ctx;
+  vector<int> &found = world.chunk_candidates[chunk];
+  for(int i=first; i<last; i++)
+  {
+    world.lazer_best[i] = -1;
+    world.lazer_best_t[i] = 2;
+    if(world.p[i] == 1)
+    {
+      float y0 = world.prev_y[i] - world.fall_step;
+      brickGridQuery(world.brick_grid, world.sweep_lo[i], min(y0, world.tip_y[i]), world.sweep_hi[i], max(y0, world.tip_y[i]), found);
+      for(int c=0; c<(int)found.size(); c++)
+        closestHit(world, i, found[c], world.lazer_best[i], world.lazer_best_t[i]);
+    }
+  }
+}
+
+static void findHitsSap (int first, int last, int chunk, void *ctx)
+{
+  World &world = *(World*)ctx;
+  for(int i=first; i<last; i++)
+  {
+    world.lazer_best[i] = -1;
+    world.lazer_best_t[i] = 2;
+    for(int k=world.sap_first[i]; k<world.sap_first[i+1]; k++)
+      closestHit(world, i, world.brick_sap.pairs[k] & 0xffffffff, world.lazer_best[i], world.lazer_best_t[i]);
+  }
+}
+
+/* Find every laser's first brick in parallel; only reads the columns */
+static void findHits (World &world)
+{
+  int n = world.n, n1 = world.n1;
+  world.lazer_best.resize(n1);
+  world.lazer_best_t.resize(n1);
+  if(world.collision_backend == COLLIDE_GRID)
+  {
+    // Each laser only tests the bricks in the cells its sweep touches
+    buildBrickGrid(world.brick_grid, world.x.data(), world.y.data(), world.e.data(), n);
+    // Only ever grown, so the lists keep their capacity
+    if((int)world.chunk_candidates.size() < jobChunks(n1, LAZER_GRAIN))
+      world.chunk_candidates.resize(jobChunks(n1, LAZER_GRAIN));
+    runJobs(world, n1, LAZER_GRAIN, findHitsGrid);
+  }
+  else if(world.collision_backend == COLLIDE_SAP)
+  {
+    // Pairs come sorted by laser, so each laser's candidates are contiguous
+    updateSweepAndPrune(world.brick_sap, world.x.data(), world.e.data(), n, world.sweep_lo.data(), world.sweep_hi.data(), world.p.data(), n1);
+    world.sap_first.assign(n1+1, 0);
+    for(int k=0; k<(int)world.brick_sap.pairs.size(); k++)
+      world.sap_first[(world.brick_sap.pairs[k] >> 32) + 1]++;
+    for(int i=0; i<n1; i++)
+      world.sap_first[i+1] += world.sap_first[i];
+    runJobs(world, n1, LAZER_GRAIN, findHitsSap);
+  }
+  else
+  {
+    // Split the bricks rather than the lasers, there are far more of them
+    int chunks = jobChunks(n, BRICK_GRAIN);
+    world.chunk_best.resize(chunks*n1);
+    world.chunk_best_t.resize(chunks*n1);
+    runJobs(world, n, BRICK_GRAIN, findHitsBrute);
+    for(int i=0; i<n1; i++)
+    {
+      world.lazer_best[i] = -1;
+      world.lazer_best_t[i] = 2;
+      for(int c=0; c<chunks; c++)
+      {
+        if(world.chunk_best_t[c*n1 + i] < world.lazer_best_t[i])
+        {
+          world.lazer_best[i] = world.chunk_best[c*n1 + i];
+          world.lazer_best_t[i] = world.chunk_best_t[c*n1 + i];
+        }
+      }
+    }
+  }
+}
+
+/* First brick laser i reaches among the live ones, searched on this thread */
+static int findHit (World &world, int i)
+{
+  int best = -1;
+  float best_t = 2;
+  if(world.collision_backend == COLLIDE_GRID)
+  {
+    float y0 = world.prev_y[i] - world.fall_step;
+    brickGridQuery(world.brick_grid, world.sweep_lo[i], min(y0, world.tip_y[i]), world.sweep_hi[i], max(y0, world.tip_y[i]), world.candidates);
+    for(int c=0; c<(int)world.candidates.size(); c++)
+      closestHit(world, i, world.candidates[c], best, best_t);
+  }
+  else if(world.collision_backend == COLLIDE_SAP)
+  {
+    for(int k=world.sap_first[i]; k<world.sap_first[i+1]; k++)
+      closestHit(world, i, world.brick_sap.pairs[k] & 0xffffffff, best, best_t);
+  }
+  else
+  {
+    bruteHit(world, i, 0, world.n, best, best_t);
+  }
+  return best;
+}
+
+static void classifyCatches (int first, int last, int chunk, void *ctx)
+{
+  World &world = *(World*)ctx;
+  for(int c=first; c<last; c++)
+  {
+    int k = world.catch_queue.in_band[c];
+    world.catch_baskets[c] = 0;
+    if(world.e[k] == 1 && sweptThroughBand(world.y[k]+world.fall_step, world.y[k], -2.85, -2.82))
+    {
+      if(world.x[k] >= -2.5+world.q1 && world.x[k] <= -1.5+world.q1)
+      {
+        world.catch_baskets[c] |= 1;
+      }
+      if(world.x[k] >= 1.5+world.q2 && world.x[k] <= 2.5+world.q2)
+      {
+        world.catch_baskets[c] |= 2;
+      }
+    }
+  }
+}
+
+static void fallBricks (int first, int last, int chunk, void *ctx)
+{
+  World &world = *(World*)ctx;
+  for(int i=first;i<last;i++)
+  {
+    world.y[i]=world.y[i]-world.fall_step;
+  }
+}
+
+/* Apply the actions that step once per key event */
+static void stepInput (World &world, const InputFrame &input)
+{
+  unsigned stepped = input.stepped;
+  world.q1 = stepControl(world.q1, actionBit(stepped, INPUT_RED_RIGHT), actionBit(stepped, INPUT_RED_LEFT), 0.2);
+  world.q2 = stepControl(world.q2, actionBit(stepped, INPUT_GREEN_RIGHT), actionBit(stepped, INPUT_GREEN_LEFT), 0.2);
+  world.q3 = stepControl(world.q3, actionBit(stepped, INPUT_SHOOTER_UP), actionBit(stepped, INPUT_SHOOTER_DOWN), 0.2);
+  world.angle = stepControl(world.angle, actionBit(stepped, INPUT_AIM_UP), actionBit(stepped, INPUT_AIM_DOWN), 5);
+}
+
+void stepWorld (World &world, const InputFrame &input)
+{
+  stepInput(world, input);
+  world.ct++;
+  bool spawn = world.ct == SPAWN_TICKS;
+  if(spawn)
+  {
+    world.ct = 0;
+  }
+  world.delay++;
+  bool fire = inputHeld(input, INPUT_FIRE) && world.delay >= FIRE_TICKS;
+  float fire_y = 0, heading = world.angle;
+  if(fire)
+  {
+    world.delay = 0;
+    fire_y = fireHeight(world.q3, world.angle);
+  }
+  world.q1 = clampControl(world.q1, -2, 3.5, -2, 0.2);
+  world.q2 = clampControl(world.q2, 2, 3.5, -2, 0.2);
+  world.q3 = clampControl(world.q3, 0, 3.75, -3.75, 0.2);
+  world.angle = clampControl(world.angle, 0, 80, -80, 5);
+  stepField(world, spawn, fire, fire_y, heading, fallStep(input.held));
+}
+
+void stepField (World &world, bool spawn, bool fire, float fire_y, float heading, float fall_step)
+{
+  world.events.clear();
+  turnMirrors(world);
+
+  if(spawn)
+  {
+    float a=rngBelow(world.rng, 7) +0.85;
+    a=a-3;
+    float b=4.2;
+    float c=rngBelow(world.rng, 3);
+    world.x.push_back(a);
+    world.y.push_back(b);
+    world.z.push_back(c);
+    world.e.push_back(1);
+    scheduleCatch(world.catch_queue, world.n, world.fallen + (b - -2.82));
+    world.n++;
+  }
+  if(fire)
+  {
+    fireLazer(world, fire_y, heading);
+    report(world, EVENT_FIRE);
+  }
+
+  // Laser tips for this tick, and the box each one swept since the last
+  int n1 = world.n1;
+  world.tip_x.resize(n1);
+  world.tip_y.resize(n1);
+  world.sweep_lo.resize(n1);
+  world.sweep_hi.resize(n1);
+  for(int i=0; i<n1; i++)
+  {
+    float dx, dy;
+    if(world.p[i]==1)
+    {
+      lazerPoint(world, i, world.r[i], world.beam_seg[i], world.tip_x[i], world.tip_y[i], dx, dy);
+    }
+    else
+    {
+      // Spent lasers stay where they stopped, which keeps the columns a
+      // function of the saved state
+      world.tip_x[i] = world.prev_x[i];
+      world.tip_y[i] = world.prev_y[i];
+    }
+    world.sweep_lo[i] = min(world.prev_x[i], world.tip_x[i]);
+    world.sweep_hi[i] = max(world.prev_x[i], world.tip_x[i]);
+  }
+
+  // Search in parallel, then settle the hits in laser order; a laser whose
+  // brick an earlier laser already took this tick searches again
+  findHits(world);
+  for(int i=0; i<n1; i++)
+  {
+    int best = world.lazer_best[i];
+    if(best >= 0 && world.e[best] != 1)
+    {
+      best = findHit(world, i);
+    }
+    if(best >= 0)
+    {
+      hitBrick(world, i, best);
+    }
+  }
+  world.prev_x = world.tip_x;
+  world.prev_y = world.tip_y;
+
+  for(int j=0;j<n1;j++)
+  {
+    if(world.p[j]==1)
+    {
+      advanceLazer(world, j, LAZER_STEP);
+    }
+  }
+
+  // Only the bricks that have reached the catch band are tested against the
+  // baskets; they stay candidates until they are caught, shot or below it
+  CatchQueue &queue = world.catch_queue;
+  dueCatches(queue, world.fallen + CATCH_MARGIN);
+  world.catch_baskets.resize(queue.in_band.size());
+  runJobs(world, queue.in_band.size(), CATCH_GRAIN, classifyCatches);
+  int kept = 0;
+  for(int c=0; c<(int)queue.in_band.size(); c++)
+  {
+    int k = queue.in_band[c];
+    if(world.catch_baskets[c] & 1)
+    {
+      world.e[k]=0;
+      report(world, EVENT_CATCH);
+      if(world.z[k]==0)
+      {
+        world.score=world.score+1;
+      }
+      else if(world.z[k]==1)
+      {
+        world.score=world.score-1;
+      }
+      else if(world.z[k]==2)
+      {
+        report(world, EVENT_BLACK_BRICK);
+      }
+      report(world, EVENT_SCORE);
+    }
+    if(world.catch_baskets[c] & 2)
+    {
+      world.e[k]=0;
+      report(world, EVENT_CATCH);
+      if(world.z[k]==0)
+      {
+        world.score=world.score-1;
+      }
+      else if(world.z[k]==1)
+      {
+        world.score=world.score+1;
+      }
+      else if(world.z[k]==2)
+      {
+        report(world, EVENT_BLACK_BRICK);
+      }
+      report(world, EVENT_SCORE);
+    }
+    if(world.e[k] == 1 && world.y[k] >= -2.85)
+    {
+      queue.in_band[kept++] = k;
+    }
+  }
+  queue.in_band.resize(kept);
+
+  world.fall_step = fall_step;
+  runJobs(world, world.n, BRICK_GRAIN, fallBricks);
+  if(world.n > 0)
+  {
+    world.fallen += world.fall_step;
+  }
+}
@@ -0,0 +1,129 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <vector>
+#include "broadphase.h"
+#include "mirrors.h"
+#include "catchqueue.h"
+#include "input.h"
+#include "rng.h"
+
+/* The game without its window: all the state one game needs and the tick
+ * that advances it. Nothing here touches GL, GLFW or the audio, so it can
+ * run on a server as fast as the CPU allows; Sample_GL3_2D.cpp feeds it
+ * InputFrames and draws it. */
+
+/* Things that happened during a tick, for the front end to report */
+enum WorldEventType {
+  EVENT_SCORE,        // score or life changed
+  EVENT_LIVES_OVER,   // life reached 0
+  EVENT_BLACK_BRICK,  // a black brick fell in a basket
+  EVENT_FIRE,         // the shooter fired a laser
+  EVENT_HIT,          // a laser hit a brick
+  EVENT_CATCH         // a basket caught a brick
+};
+
+struct WorldEvent {
+  int type;
+  int score, life;    // after the event
+};
+
+struct World {
+  // Bricks: centre, colour (0 red, 1 green, 2 black) and alive flag
+  int n;
+  std::vector<float> x, y, z, e;
+  // Lasers: distance flown along the beam and alive flag
+  int n1;
+  std::vector<float> r, p;
+  int ct;                  // ticks since the last brick appeared
+  int delay;               // ticks since the last shot
+  int life, score;
+  bool over;               // set by the first game over, the tick goes on regardless
+  float q1, q2;            // red and green basket offsets
+  float q3, angle;         // shooter height and heading
+  float mirror_rotation[4];// degrees added to each level mirror
+  Rng rng;                 // brick positions and colours
+  int collision_backend;
+  bool parallel;           // split the tick into jobs; off when worlds already run in parallel
+
+  float fall_step;         // distance the bricks fell this tick
+  double fallen;           // total distance every brick has fallen, the clock of the catch queue
+  CatchQueue catch_queue;
+
+  // Laser tips for this tick, where they were last tick and the x span between
+  std::vector<float> tip_x, tip_y, prev_x, prev_y, sweep_lo, sweep_hi;
+  // Laser i flies r[i] along the polyline in slot i of the beam_ columns
+  std::vector<float> beam_x, beam_y, beam_len;
+  std::vector<int> beam_count, beam_seg;
+
+  std::vector<Mirror> mirrors;
+  MirrorBVH mirror_bvh;
+  BrickGrid brick_grid;
+  SweepAndPrune brick_sap;
+
+  // Scratch for the parallel collision and catch stages
+  std::vector<int> candidates;
+  std::vector<int> lazer_best;
+  std::vector<float> lazer_best_t;
+  std::vector<int> chunk_best;
+  std::vector<float> chunk_best_t;
+  std::vector< std::vector<int> > chunk_candidates;
+  std::vector<int> sap_first;
+  std::vector<int> catch_baskets;
+
+  std::vector<WorldEvent> events;  // this tick's, cleared by stepWorld()
+
+  World ();  // a new game from seed 0 on the grid backend, in parallel
+};
+
+/* Start a new game whose bricks come from seed; keeps the collision
+ * backend, the parallel flag and the capacity of every column, so a reset
+ * world doesn't allocate again */
+void resetWorld (World &world, uint64_t seed);
+
+/* Make room for this many bricks and lasers up front, so a game that
+ * stays within them doesn't allocate while it runs */
+void reserveWorld (World &world, int bricks, int lazers);
+
+/* Advance the game by one fixed tick (1/60 s) */
+void stepWorld (World &world, const InputFrame &input);
+
+/* The part of a tick after the scalars (controls.h) have moved: drop a
+ * brick if spawn, fire from height fire_y at heading degrees if fire, then
+ * the lasers, the catches against q1 and q2, and the fall, fall_step from
+ * this tick on. stepWorld() is the scalars and then this; batch.cpp moves
+ * the scalars of many games in columns and calls this for each. */
+void stepField (World &world, bool spawn, bool fire, float fire_y, float heading, float fall_step);
+
+/* Fire a laser from the shooter at height py, heading degrees */
+void fireLazer (World &world, float py, float heading);
+
+/* Point and heading of laser i at distance dist along its beam */
+void lazerPoint (const World &world, int i, float dist, int &seg, float &px, float &py, float &dx, float &dy);
+
+/* For a world that is only drawn, as a spectator's: make room for n1
+ * lasers, then put each with placeLazer() as a straight beam through its
+ * tip at (x, y), heading radians */
+void showLazers (World &world, int n1);
+
+void placeLazer (World &world, int i, float x, float y, float heading, bool alive);
+
+/* A copy of a game's state in one flat buffer: a fixed header with the
+ * scalars and column lengths, then every column back to back. Only what
+ * the next tick depends on is saved, plus the sweep and prune lists,
+ * which are kept up a tick at a time and would cost an insertion sort of
+ * every brick to rebuild; the grid and scratch are rebuilt from it. Each
+ * column is one memcpy. Saving into the same snapshot again, or restoring
+ * into a world that held as much, doesn't allocate. */
+struct WorldSnapshot {
+  std::vector<unsigned char> data;
+};
+
+void saveWorld (const World &world, WorldSnapshot &snapshot);
+
+void restoreWorld (World &world, const WorldSnapshot &snapshot);
+
+/* Distance a laser flies per tick */
+#define LAZER_STEP 0.1f
+
+#endif